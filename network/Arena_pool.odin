@@ -0,0 +1,77 @@
+package network
+
+import "core:fmt"
+
+import mem_virtual "core:mem/virtual"
+
+import "../utils"
+
+Arena_pool_max_free :: 64;					//Arenas above this count are destroyed when released, instead of being kept.
+Arena_pool_max_kept_size :: 4 * 1024 * 1024;	//Arenas that grew beyond this are destroyed when released, so one huge message does not pin its memory forever.
+
+//Recycles the arenas holding the value of parsed commands, so a steady stream of messages does not reserve/release virtual memory per message.
+//There is one per Client_base, commands are returned to it with destroy_command.
+Arena_pool :: struct {
+	free_arenas : [dynamic]^mem_virtual.Arena,
+	mutex : utils.Mutex,
+
+	arenas_created : int,		//The amount of arenas ever created by this pool (an OS level reservation each), this stays flat in steady state.
+}
+
+arena_pool_init :: proc (using pool : ^Arena_pool, alloc := context.allocator) {
+	free_arenas = make([dynamic]^mem_virtual.Arena, 0, Arena_pool_max_free, alloc);
+	arenas_created = 0;
+}
+
+//All arenas handed out must have been released before this is called.
+arena_pool_destroy :: proc (using pool : ^Arena_pool) {
+	lock(&mutex);
+	defer unlock(&mutex);
+
+	for arena in free_arenas {
+		mem_virtual.arena_destroy(arena);
+		free(arena);
+	}
+	delete(free_arenas);
+	free_arenas = nil;
+}
+
+//Returns an empty arena, it is only created if the pool has no free arenas.
+arena_pool_get :: proc (using pool : ^Arena_pool) -> ^mem_virtual.Arena {
+	lock(&mutex);
+	defer unlock(&mutex);
+
+	if len(free_arenas) != 0 {
+		return pop(&free_arenas);
+	}
+
+	arena := new(mem_virtual.Arena);
+	err := mem_virtual.arena_init_growing(arena);
+	fmt.assertf(err == nil, "Failed to create arena, err : %v", err);
+	arenas_created += 1;
+
+	return arena;
+}
+
+//Resets the arena and keeps it for reuse, the first memory block stays committed.
+arena_pool_release :: proc (using pool : ^Arena_pool, arena : ^mem_virtual.Arena) {
+
+	if arena.total_reserved > Arena_pool_max_kept_size {
+		mem_virtual.arena_destroy(arena);
+		free(arena);
+		return;
+	}
+
+	mem_virtual.arena_free_all(arena);
+
+	lock(&mutex);
+	defer unlock(&mutex);
+
+	if len(free_arenas) >= Arena_pool_max_free {
+		mem_virtual.arena_destroy(arena);
+		free(arena);
+		return;
+	}
+
+	append(&free_arenas, arena);
+}
@@ -14,6 +14,7 @@ import "../tracy"
 Client :: struct {
     using base : Client_base,
     params : Network_params,
+    writer : Writer,                //Only used when params.use_send_queues
 }
 
 /////////////////////////////////////////////////////////
@@ -54,12 +55,15 @@ Connect_client :: proc(using client : ^Client, server_endpoint : net.Endpoint) {
 
     recive_thread = thread.create(client_recive_loop, client);
 
-    queue.init(&current_bytes_recv);
-    queue.init(&recv_commands);
-    allowed_commands = make(typeid_set);
-    for k, v in client.params.initial_allowed_commands {
-        allowed_commands[k] = v;
+    recv_buffer_init(&current_bytes_recv);
+    arena_pool_init(&arena_pool);
+    if client.params.use_send_queues {
+        writer_start(&writer);
+        send_queue_init(&send_queue, socket, &writer, client.params.send_queue_config);
     }
+    queue.init(&recv_commands);
+    allowed_commands = make_allowed_commands(client.params);
+    traffic_counters_init(&metrics, client.params);
     
     unlock(&mutex);
 
@@ -72,6 +76,12 @@ close_client :: proc(using client : ^Client) {
 
     should_close = true;
     
+    //Whatever is still queued is send before the socket is closed.
+    send_queue_destroy(&send_queue);
+    if params.use_send_queues {
+        writer_destroy(&writer);
+    }
+
     lock(&mutex);
     net.close(socket);
     unlock(&mutex);
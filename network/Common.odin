@@ -1,13 +1,13 @@
 package network
 
-import "base:builtin"
-
 import "core:net"
 import "base:intrinsics"
 import "core:fmt"
 import "base:runtime"
 import "core:mem"
 import "core:reflect"
+import "core:slice"
+import "core:sync"
 import "core:time"
 
 import mem_virtual "core:mem/virtual"
@@ -22,6 +22,10 @@ typeid_set :: map[typeid]struct{};
 
 message_id_type :: distinct u16;
 client_id_type :: int;
+command_index_type :: u16;                      //A dense index into Network_params.command_infos
+
+//One bit per command (by command index), set if the command is allowed.
+Command_bitset :: []u64;
 
 lock :: utils.lock;
 unlock :: utils.unlock;
@@ -34,12 +38,34 @@ Network_params :: struct {
     command_allowing            : map[typeid][]typeid,
     command_disallowing         : map[typeid][]typeid,
     initial_allowed_commands    : typeid_set,
+
+    //The compiled dispatch table, so parsing a message does no map lookups.
+    command_infos               : []Command_info,           //Dense, indexed by command index
+    command_index               : []command_index_type,     //Indexed by message_id, this is the command index + 1 (0 is not a command)
+    initial_allowed_bits        : Command_bitset,
     
     custem_user_data_cleanup_func : proc(data_to_clean : any),
+
+    use_send_queues : bool,                     //Outbound messages are queued and send by a writer thread, see enable_send_queues.
+    send_queue_config : Send_queue_config,
+
+    collect_metrics : bool,                     //Count the traffic per connection and command, see enable_metrics.
     
     is_init : bool,
 }
 
+Command_info :: struct {
+    type        : typeid,
+    id          : message_id_type,
+    index       : command_index_type,
+    size        : int,                          //size_of the type
+    is_trivial  : bool,                         //utils.is_trivial_copied of the type (false for compact commands, they need the size header)
+    zero_copy   : bool,                         //Recived as a view into the recive buffer, see enable_zero_copy
+    compact     : bool,                         //Uses the compact encoding, see enable_compact
+    allowing    : []command_index_type,         //The commands allowed after this command is recived
+    disallowing : []command_index_type,         //The commands disallowed after this command is recived
+}
+
 ////////////////////////////////////////////////
 
 /*
@@ -55,12 +81,26 @@ net_interface :: struct {
 Client_base :: struct {
     
     //Data
-    current_bytes_recv  : queue.Queue(u8),      //This fills up and must be handled somehow
+    current_bytes_recv  : Recv_buffer,          //Bytes are recived into the tail and parsed from the head
     recv_commands       : queue.Queue(Command),     //This should be handle in the main thread and is locked by commands_mutex
 	commands_mutex 		: utils.Mutex,
+	commands_cond		: sync.Cond,			//Signaled (with commands_mutex) when a command is added to recv_commands.
+	arena_pool			: Arena_pool,			//Recycles the memory of the commands, commands must be destroyed before the client is.
+
+    //Outbound, only used when params.use_send_queues
+    send_queue : Send_queue,
 
     //What commands can this socket able to recive
-    allowed_commands    : typeid_set,           //This is a "set" datastructure
+    allowed_commands    : Command_bitset,       //Indexed by command index, see command_allowed
+
+    //Only used when params.collect_metrics
+    metrics             : Traffic_counters,
+    server_metrics      : ^Traffic_counters,    //The server wide aggregate, nil on the client side.
+
+    //Set while the server is recording, see start_recording
+    recorder            : ^Recorder,
+    dispatcher          : ^Dispatcher,          //Set when the server hands the commands to the job workers (atomic), see start_dispatch
+    connection_id       : client_id_type,     //The client id on the server side.
 
 	socket : net.TCP_Socket,
 
@@ -79,10 +119,13 @@ Client_base :: struct {
 }
 
 Command :: struct {
-	arena_alloc : ^mem_virtual.Arena, //hold the memory for value, free when done with value.
+	arena_alloc : ^mem_virtual.Arena, //hold the memory for value, free when done with value (using destroy_command).
+	pool : ^Arena_pool,				  //The pool arena_alloc is returned to.
 	alloc :	mem.Allocator,
 	value : any,
 	is_constant_size : bool,
+	owns_memory : bool,				  //false for zero copy commands, then value points into view_of and is valid until destroy_command.
+	view_of : ^Recv_block,
 }
 
 ////////////////////////////////////////////////
@@ -104,6 +147,47 @@ make_params :: proc(data_cleanup_func : proc(data_to_clean : any), commands_map
         commands_inverse[com] = id;
     }
 
+    /////////// Compile the dispatch table ///////////
+    fmt.assertf(len(commands) <= cast(int)max(command_index_type), "Too many commands, there can at most be %v", max(command_index_type));
+
+    command_infos = make([]Command_info, len(commands));
+    command_index = make([]command_index_type, cast(int)max(message_id_type) + 1);
+
+    index := 0;
+    for id, com in commands {
+        command_infos[index] = Command_info{
+            type = com,
+            id = id,
+            index = cast(command_index_type)index,
+            size = reflect.size_of_typeid(com),
+            is_trivial = utils.is_trivial_copied(com),
+        };
+        command_index[id] = cast(command_index_type)(index + 1);
+        index += 1;
+    }
+
+    to_indices :: proc(params : Network_params, types : []typeid) -> []command_index_type {
+        res := make([]command_index_type, len(types));
+        for t, i in types {
+            res[i] = command_index_of(params, t);
+        }
+        return res;
+    }
+
+    for &info in command_infos {
+        if list, ok := command_allowing[info.type]; ok {
+            info.allowing = to_indices(net_params, list);
+        }
+        if list, ok := command_disallowing[info.type]; ok {
+            info.disallowing = to_indices(net_params, list);
+        }
+    }
+
+    initial_allowed_bits = make(Command_bitset, (len(command_infos) + 63) / 64);
+    for t in initial_allowed_commands {
+        command_bitset_set(initial_allowed_bits, command_index_of(net_params, t), true);
+    }
+
     is_init = true;
 
     return net_params;
@@ -112,6 +196,71 @@ make_params :: proc(data_cleanup_func : proc(data_to_clean : any), commands_map
 delete_params :: proc(using params : ^Network_params) {
 	
 	delete(commands_inverse);
+
+    for info in command_infos {
+        delete(info.allowing);
+        delete(info.disallowing);
+    }
+    delete(command_infos);
+    delete(command_index);
+    delete(initial_allowed_bits);
+}
+
+//The dense index of a command type.
+command_index_of :: proc(params : Network_params, t : typeid, loc := #caller_location) -> command_index_type {
+    id, ok := params.commands_inverse[t];
+    fmt.assertf(ok, "The type %v is not a command", t, loc = loc);
+    return params.command_index[id] - 1;
+}
+
+command_bitset_get :: #force_inline proc(bits : Command_bitset, index : command_index_type) -> bool {
+    return bits[index >> 6] & (1 << (index & 63)) != 0;
+}
+
+command_bitset_set :: #force_inline proc(bits : Command_bitset, index : command_index_type, value : bool) {
+    if value {
+        bits[index >> 6] |= 1 << (index & 63);
+    }
+    else {
+        bits[index >> 6] &~= 1 << (index & 63);
+    }
+}
+
+//The commands of the given (trivially copyable) types are recived as views directly into the recive buffer, so they are never copied or allocated.
+//A view is valid until destroy_command, until then the recive buffer keeps the bytes in place, so do not hold on to them for long.
+enable_zero_copy :: proc(params : ^Network_params, types : ..typeid, loc := #caller_location) {
+    for t in types {
+        info := &params.command_infos[command_index_of(params^, t, loc)];
+        fmt.assertf(info.is_trivial, "Only trivially copyable commands can be zero copy, %v is not", t, loc = loc);
+        info.zero_copy = true;
+    }
+}
+
+//The commands of the given types use the compact encoding (varints and quantized floats, see utils/Serialize_compact.odin), so they are smaller but take longer to encode.
+//Both ends must enable it for the same commands, they are always send with the size header, even if they are trivially copyable.
+enable_compact :: proc(params : ^Network_params, types : ..typeid, loc := #caller_location) {
+    for t in types {
+        info := &params.command_infos[command_index_of(params^, t, loc)];
+        fmt.assertf(!info.zero_copy, "%v is zero copy, it cannot be compact", t, loc = loc);
+        info.compact = true;
+        info.is_trivial = false;
+    }
+}
+
+//The value of a command as a typed pointer, for zero copy commands this points into the recive buffer (and might not be aligned).
+command_view :: proc(com : Command, $T : typeid, loc := #caller_location) -> ^T {
+    fmt.assertf(com.value.id == T, "Expected command %v, got %v", typeid_of(T), com.value.id, loc = loc);
+    return cast(^T)com.value.data;
+}
+
+//The commands a new connection is allowed to recive, free with delete.
+make_allowed_commands :: proc(params : Network_params) -> Command_bitset {
+    return slice.clone(params.initial_allowed_bits);
+}
+
+//Returns true if the client is allowed to recive the command (type).
+command_allowed :: proc(client : ^Client_base, params : Network_params, t : typeid) -> bool {
+    return command_bitset_get(client.allowed_commands, command_index_of(params, t));
 }
 
 //return true if error
@@ -153,22 +302,110 @@ send_message_variable_size :: proc (socket : net.TCP_Socket, using params : Netw
     tracy.Zone();
     fmt.assertf(data.id in commands_inverse, "The data %v is not a command as it is not in the map : %#v", data.id, commands_inverse, loc);
 
+    stack : [Send_stack_bytes]u8;
+    to_send, allocated, s_err := _encode_for_send(params, data, stack[:], loc);
+    fmt.assertf(s_err == .ok, "Failed to encode %v, err : %v", data.id, s_err, loc);
+    defer if allocated {
+        delete(to_send);
+    }
+
+    return send_bytes(socket, to_send);
+}
+
+//Appends the message id and the (serialized) value to "to", these are the exact bytes send_message sends.
+encode_message :: proc (using params : Network_params, data : any, to : ^[dynamic]u8, loc := #caller_location) -> utils.Serialization_error {
+    size, err := encoded_message_size(params, data, loc);
+    if err != .ok {
+        return err;
+    }
+
+    at := len(to);
+    non_zero_resize(to, at + size);
+    _, err = encode_message_into(params, data, to[at:], loc);
+    return err;
+}
+
+//The size of what encode_message writes.
+encoded_message_size :: proc (using params : Network_params, data : any, loc := #caller_location) -> (size : int, err : utils.Serialization_error) {
+    fmt.assertf(data.id in commands_inverse, "The data %v is not a command as it is not in the map : %#v", data.id, commands_inverse, loc);
+
     command_id : message_id_type = commands_inverse[data.id];
+    if command_infos[command_index[command_id] - 1].is_trivial {
+        return size_of(message_id_type) + reflect.size_of_typeid(data.id), .ok;
+    }
 
-    to_send : [dynamic]u8 = make([dynamic]u8, size_of(message_id_type));
-    runtime.mem_copy(&to_send[0], &command_id, size_of(message_id_type));
+    if command_infos[command_index[command_id] - 1].compact {
+        size, err = utils.compact_serialized_size(data);
+    }
+    else {
+        size, err = utils.serialized_size(data);
+    }
+    return size_of(message_id_type) + size, err;
+}
 
-    utils.serialize_to_bytes(data, &to_send, loc);
-    defer delete(to_send);
+//Writes the same bytes as encode_message into buf, returns .buffer_too_small if it does not fit (see encoded_message_size).
+encode_message_into :: proc (using params : Network_params, data : any, buf : []u8, loc := #caller_location) -> (written : int, err : utils.Serialization_error) {
+    fmt.assertf(data.id in commands_inverse, "The data %v is not a command as it is not in the map : %#v", data.id, commands_inverse, loc);
 
-    bytes_send, serr := net.send(socket, to_send[:]);
+    if len(buf) < size_of(message_id_type) {
+        return 0, .buffer_too_small;
+    }
+    command_id : message_id_type = commands_inverse[data.id];
+    runtime.mem_copy(&buf[0], &command_id, size_of(message_id_type));
+
+    if command_infos[command_index[command_id] - 1].is_trivial {
+        command_size := reflect.size_of_typeid(data.id);
+        if len(buf) < size_of(message_id_type) + command_size {
+            return 0, .buffer_too_small;
+        }
+        if command_size > 0 {
+            runtime.mem_copy(&buf[size_of(message_id_type)], data.data, command_size);
+        }
+        return size_of(message_id_type) + command_size, .ok;
+    }
+
+    if command_infos[command_index[command_id] - 1].compact {
+        written, err = utils.serialize_compact_into(data, buf[size_of(message_id_type):]);
+    }
+    else {
+        written, err = utils.serialize_into(data, buf[size_of(message_id_type):]);
+    }
+    return size_of(message_id_type) + written, err;
+}
+
+//Messages up to this size are encoded on the stack when send directly.
+Send_stack_bytes :: 2048;
+
+//Encodes into stack if the message fits, otherwise into an allocation the caller must delete (allocated is true).
+@(private)
+_encode_for_send :: proc (params : Network_params, data : any, stack : []u8, loc := #caller_location) -> (bytes : []u8, allocated : bool, err : utils.Serialization_error) {
+    size : int;
+    size, err = encoded_message_size(params, data, loc);
+    if err != .ok {
+        return nil, false, err;
+    }
+
+    buf := stack;
+    if size > len(stack) {
+        buf = make([]u8, size);
+        allocated = true;
+    }
+
+    written : int;
+    written, err = encode_message_into(params, data, buf[:size], loc);
+    return buf[:written], allocated, err;
+}
+
+//Sends already encoded bytes, returns true if error.
+send_bytes :: proc (socket : net.TCP_Socket, bytes : []u8) -> (err : bool) {
+    bytes_send, serr := net.send(socket, bytes);
 
     if serr != nil {
         fmt.printf("Failed to send, recived err %v\n", serr);
         return true;
     }
-    if bytes_send != len(to_send) {
-        fmt.printf("Failed to send all bytes, tried to send %i, but only sent %i\n", len(to_send), bytes_send);
+    if bytes_send != len(bytes) {
+        fmt.printf("Failed to send all bytes, tried to send %i, but only sent %i\n", len(bytes), bytes_send);
         return true;
     }
 
@@ -177,7 +414,8 @@ send_message_variable_size :: proc (socket : net.TCP_Socket, using params : Netw
 
 send_message_params :: proc (socket : net.TCP_Socket, params : Network_params, data : any, loc := #caller_location) -> (err : bool) {
 	tracy.Zone();
-    if(utils.is_trivial_copied(data.id)) {
+    fmt.assertf(data.id in params.commands_inverse, "The data %v is not a command as it is not in the map : %#v", data.id, params.commands_inverse, loc);
+    if params.command_infos[command_index_of(params, data.id)].is_trivial {
         return send_message_constant_size(socket, params, data, loc);
     }
     else {
@@ -185,12 +423,116 @@ send_message_params :: proc (socket : net.TCP_Socket, params : Network_params, d
     }
 }
 
+//Goes through the send queue if send queues are enabled.
 send_message_client :: proc (client : ^Client, data : any, loc := #caller_location) -> (err : bool) {
+    if client.params.use_send_queues {
+        return queue_message(client, client.params, data, loc);
+    }
+    if len(client.metrics.commands) != 0 {
+        return _send_message_counted(client, client.params, data, loc);
+    }
     return send_message_params(client.socket, client.params, data, loc);
 }
 
-send_message :: proc{send_message_client, send_message_params};
+//Goes through the send queue if send queues are enabled.
+send_message_server_client :: proc (server : ^Server, client : ^Server_side_client, data : any, loc := #caller_location) -> (err : bool) {
+    if server.params.use_send_queues {
+        return queue_message(client, server.params, data, loc);
+    }
+    if len(client.metrics.commands) != 0 {
+        return _send_message_counted(client, server.params, data, loc);
+    }
+    return send_message_params(client.socket, server.params, data, loc);
+}
 
+//Like send_message_params, but the encoded size is counted in the clients metrics.
+@(private)
+_send_message_counted :: proc (client : ^Client_base, params : Network_params, data : any, loc := #caller_location) -> (err : bool) {
+    stack : [Send_stack_bytes]u8;
+    to_send, allocated, s_err := _encode_for_send(params, data, stack[:], loc);
+    fmt.assertf(s_err == .ok, "Failed to encode %v, err : %v", data.id, s_err, loc);
+    defer if allocated {
+        delete(to_send);
+    }
+
+    metrics_record_out(client, params, to_send);
+    return send_bytes(client.socket, to_send);
+}
+
+send_message :: proc{send_message_client, send_message_server_client, send_message_params, send_message_delta};
+
+//An encoded message that can be send to many sockets, it is freed when the last reference is released.
+Shared_message :: struct {
+	data : []u8,				//The message id followed by the (serialized) value
+	refs : int,					//atomic
+	allocator : mem.Allocator,
+}
+
+//Encodes the value once, the result starts with 1 reference.
+make_shared_message :: proc (params : Network_params, data : any, alloc := context.allocator, loc := #caller_location) -> (msg : ^Shared_message, err : utils.Serialization_error) {
+	tracy.Zone();
+
+	size : int;
+	size, err = encoded_message_size(params, data, loc);
+	if err != .ok {
+		return nil, err;
+	}
+
+	encoded := make([]u8, size, alloc);
+	_, err = encode_message_into(params, data, encoded, loc);
+	if err != .ok {
+		delete(encoded, alloc);
+		return nil, err;
+	}
+
+	msg = new(Shared_message, alloc);
+	msg.data = encoded;
+	msg.refs = 1;
+	msg.allocator = alloc;
+
+	return msg, .ok;
+}
+
+shared_message_retain :: proc (msg : ^Shared_message) {
+	intrinsics.atomic_add(&msg.refs, 1);
+}
+
+shared_message_release :: proc (msg : ^Shared_message) {
+	if intrinsics.atomic_sub(&msg.refs, 1) == 1 {
+		delete(msg.data, msg.allocator);
+		free(msg, msg.allocator);
+	}
+}
+
+//Frees the memory holding the command value, the value must not be used afterwards.
+//The arena is returned to the pool of the client it was recived by, so this does no OS level freeing in steady state.
+//For zero copy commands this releases the view, so the recive buffer may reuse the bytes.
+destroy_command :: proc(com : Command) {
+	if com.view_of != nil {
+		recv_buffer_release_view(com.view_of);
+	}
+
+	if com.arena_alloc == nil {
+		return;
+	}
+	
+	if com.pool != nil {
+		arena_pool_release(com.pool, com.arena_alloc);
+	}
+	else {
+		mem_virtual.arena_destroy(com.arena_alloc);
+		free(com.arena_alloc);
+	}
+}
+
+//Destroys a batch of handled commands at once.
+destroy_commands :: proc(coms : []Command) {
+	for com in coms {
+		destroy_command(com);
+	}
+}
+
+//Blocks until a command arrives (woken by the recive thread, there is no polling) or the timeout is reached.
 wait_for_message :: proc(using client : ^Client_base, $message_type : typeid, timeout : time.Duration = 5 * time.Second, loc := #caller_location) -> (mes : message_type, err : bool) {
     using time;
 	tracy.Zone();
@@ -200,41 +542,27 @@ wait_for_message :: proc(using client : ^Client_base, $message_type : typeid, ti
 
     timer : time.Stopwatch;
     stopwatch_start(&timer);
+    defer stopwatch_stop(&timer);
 
-    for true {
-		
-		{
-			lock(&commands_mutex);
-			defer unlock(&commands_mutex);
-			if queue.len(recv_commands) != 0 {
-				
-				com : Command = queue.pop_front(&recv_commands);
-				command := com.value;
-
-				fmt.assertf(message_type == command.id, "Expected commands %v, got %v", 0, command.id, loc);
-				mes = (cast(^message_type)command.data)^;
-				err = false;
-				
-				stopwatch_stop(&timer);
-				
-				free_all(com.alloc);
-				mem_virtual.arena_destroy(com.arena_alloc);
-				free(com.arena_alloc);
-
-				return;
-			}
-		}
-
-        dur := stopwatch_duration(timer);
-
-        if dur > timeout {
-            break;
-        }
+	lock(&commands_mutex);
+	defer unlock(&commands_mutex);
 
-        time.sleep(Millisecond);
-    }
+	for queue.len(recv_commands) == 0 {
+		remaining := timeout - stopwatch_duration(timer);
+		if remaining <= 0 {
+			return;
+		}
+		utils.cond_wait_with_timeout(&commands_cond, &commands_mutex, remaining);
+	}
+		
+	com : Command = queue.pop_front(&recv_commands);
+	command := com.value;
 
-    stopwatch_stop(&timer);
+	fmt.assertf(message_type == command.id, "Expected commands %v, got %v", 0, command.id, loc);
+	mes = (cast(^message_type)command.data)^;
+	err = false;
+	
+	destroy_command(com);
 
     return;
 }
@@ -244,10 +572,13 @@ recv_parse_loop :: proc(using client : ^Client_base, params : Network_params, lo
 
     is_open = true;
     
-    new_data_buffer : [16384]u8; //We can max recive 16384 bytes at a time.
-
     for !should_close {
-        bytes_recv, err := net.recv(socket, new_data_buffer[:]);
+        //Only this thread touches the buffer memory, so we do not hold the lock while blocking in recv.
+        lock(&mutex);
+        tail_space := recv_buffer_reserve(&current_bytes_recv, Recv_chunk_size);
+        unlock(&mutex);
+
+        bytes_recv, err := net.recv(socket, tail_space);
 
         if (err == net.TCP_Recv_Error.Aborted || err == net.TCP_Recv_Error.Connection_Closed) && should_close {
             continue;
@@ -263,9 +594,7 @@ recv_parse_loop :: proc(using client : ^Client_base, params : Network_params, lo
         }
 
         lock(&mutex);
-        for d in new_data_buffer[:bytes_recv] {
-            queue.append(&current_bytes_recv, d); //TODO this is very slow, copy all at once
-        }
+        recv_buffer_commit(&current_bytes_recv, bytes_recv);
 		unlock(&mutex);
         
         for parse_message(client, params, loc) {}; //Parses all messages...
@@ -275,96 +604,136 @@ recv_parse_loop :: proc(using client : ^Client_base, params : Network_params, lo
 
     //fmt.printf("Closing client loop for index : %v\n", t.user_index);
 
+	destroy_client_base(client);
+
+	free_all(context.temp_allocator);
+}
+
+//Frees the recive buffers and the command queue, called when nothing will recive into the client anymore.
+destroy_client_base :: proc(using client : ^Client_base) {
 	lock(&mutex);
 	defer unlock(&mutex);
 	lock(&commands_mutex);
 	defer unlock(&commands_mutex);
 
-    queue.destroy(&current_bytes_recv);
+    for queue.len(recv_commands) != 0 {
+        destroy_command(queue.pop_front(&recv_commands));
+    }
+    if dispatcher != nil {
+        dispatcher_drop_client(dispatcher, client);
+    }
+
+    recv_buffer_destroy(&current_bytes_recv);
     queue.destroy(&recv_commands);
     delete(allowed_commands);
-
-	free_all(context.temp_allocator);
+    arena_pool_destroy(&arena_pool);
+    traffic_counters_destroy(&metrics);
 }
 
 //returns true if it did parse something
 parse_message :: proc (using client : ^Client_base, params : Network_params, loc := #caller_location) -> bool {
     tracy.Zone();
 
-	try_parse :: proc(using client : ^Client_base, params : Network_params, message_id : message_id_type, command : ^Command, loc := #caller_location) -> bool{
+	try_parse :: proc(using client : ^Client_base, params : Network_params, info : ^Command_info, command : ^Command, loc := #caller_location) -> bool{
 
-		message_typeid : typeid = params.commands[message_id];		
+		message_typeid : typeid = info.type;
 		
-		tracy.Message(fmt.tprintf("trying to parsing message : %v", message_typeid));
+		when tracy.TRACY_ENABLE {
+			tracy.Message(fmt.tprintf("trying to parsing message : %v", message_typeid));
+		}
+
+		view : []u8 = recv_buffer_view(&current_bytes_recv);
+
+		take_arena :: proc(client : ^Client_base, command : ^Command) {
+			command.arena_alloc = arena_pool_get(&client.arena_pool);
+			command.pool = &client.arena_pool;
+			command.alloc = mem_virtual.arena_allocator(command.arena_alloc);
+			command.owns_memory = true;
+		}
+
+		if info.zero_copy {
+			command.is_constant_size = true;
+
+            total_size : int = size_of(message_id_type) + info.size;
+            if len(view) < total_size {
+                return false;
+            }
+
+			//The value stays in the recive buffer, destroy_command releases it.
+			command.view_of = recv_buffer_retain_view(&current_bytes_recv);
+			command.owns_memory = false;
+            command.value = {data = raw_data(view[size_of(message_id_type):]), id = message_typeid};
 
-		if utils.is_trivial_copied(message_typeid) {
+            recv_buffer_consume(&client.current_bytes_recv, total_size);
+		}
+		else if info.is_trivial {
 			command.is_constant_size = true;
 			//fmt.printf("Parsing trivical message : %v\n", message_typeid);
 
-            command_size : int = reflect.size_of_typeid(message_typeid);
+            command_size : int = info.size;
             total_size : int = size_of(message_id_type) + command_size;
             
-            if queue.len(client.current_bytes_recv) < total_size {
+            if len(view) < total_size {
                 return false;
             }
 
+            take_arena(client, command);
             command_data, err := mem.alloc_bytes(command_size, allocator = command.alloc);
 			if err != nil { panic("Unable to allocate!!?!?"); }
             
-			for i : int = 0; i < cast(int)command_size; i += 1 {
-				command_data[i] = queue.get(&current_bytes_recv, i + size_of(message_id_type));
+			if command_size > 0 {
+				mem.copy(raw_data(command_data), &view[size_of(message_id_type)], command_size);
 			}
             
             command.value = {data = raw_data(command_data), id = message_typeid};
 			//fmt.printf("Recived : %v\n", command);
 
-            queue.consume_front(&client.current_bytes_recv, total_size);
+            recv_buffer_consume(&client.current_bytes_recv, total_size);
         }
         else {
 			command.is_constant_size = false;
             //We need another header, this header is the Utils.Header_size_type
 
             req_size := size_of(message_id_type) + size_of(utils.Header_size_type);
-            if queue.len(client.current_bytes_recv) < req_size {
+            if len(view) < req_size {
                 return false;
             }
             
-            header_data : []u8 = make([]u8, size_of(utils.Header_size_type));
-			defer delete(header_data);
-            for i : int = 0; i < size_of(utils.Header_size_type); i += 1 {
-                header_data[i] = queue.get(&current_bytes_recv, i + size_of(message_id_type));
-            }
-            message_size := utils.to_type(header_data, utils.Header_size_type);
+            message_size := utils.to_type(view[size_of(message_id_type):], utils.Header_size_type);
             
 			total_size : int = size_of(message_id_type) + cast(int)message_size;
-			if queue.len(client.current_bytes_recv) < total_size {
+			if len(view) < total_size {
 				return false;
 			}
             
-			data : []u8 = make([]u8, message_size);
-            defer delete(data);
-
-            for i : int = 0; i < cast(int)message_size; i += 1 {
-                data[i] = queue.get(&current_bytes_recv, i + size_of(message_id_type));
-            }
-            queue.consume_front(&client.current_bytes_recv, total_size);
+			//The message (including the size header) is deserialized straight from the recive buffer.
+			data : []u8 = view[size_of(message_id_type):total_size];
 			
 			val : any;
 			err : utils.Serialization_error;
-            val, err = utils.deserialize_from_bytes(message_typeid, data, command.alloc);
+            take_arena(client, command);
+            if info.compact {
+                val, err = utils.deserialize_from_bytes_compact(message_typeid, data, command.alloc);
+            }
+            else {
+                val, err = utils.deserialize_from_bytes(message_typeid, data, command.alloc);
+            }
+            recv_buffer_consume(&client.current_bytes_recv, total_size);
 
 			//fmt.assertf(command_size != 0, "command_size was 0, for %v", message_typeid);
 
-            if err == .ok {
-                command.value = val;
-            }
-            else {
-                panic("Failed to deserialize_from_bytes!");
+            if err != .ok {
+				//The peer send something we can not read, it is not trusted anymore so we disconnect it.
+				fmt.printf("Failed to deserialize %v, err : %v, disconnecting client. Caller : %v\n", message_typeid, err, loc);
+				destroy_command(command^);
+				command^ = {};
+				should_close = true;
+				return false; //This blocks further messages from being parsed.
             }
+            command.value = val;
         }
 
-		//TODO check if command is allowed for this user.
-		if !(message_typeid in allowed_commands) {
+		if !command_bitset_get(allowed_commands, info.index) {
 			fmt.printf("The command : %v is not allowed disconnecting client. Caller : %v\n", message_typeid, loc);
 			//TODO : queue.append(&recv_commands, message.Disconnect{});
 			return false; //This blocks further messages from being parsed.
@@ -378,62 +747,67 @@ parse_message :: proc (using client : ^Client_base, params : Network_params, loc
 		defer unlock(&mutex);
 
 		//We want enough bytes to know the message_id, otherwise we know nothing.
-		if queue.len(client.current_bytes_recv) < size_of(message_id_type) {
+		if recv_buffer_len(client.current_bytes_recv) < size_of(message_id_type) {
 			return false;
 		}
 	}
 	
 	lock(&mutex);
-    message_data : []u8 = make([]u8, size_of(message_id_type));
-	defer delete(message_data);
-    for i : int = 0; i < size_of(message_id_type); i += 1 { //TODO no bounds check
-        message_data[i] = queue.get(&current_bytes_recv, i);
-    }
-	unlock(&mutex);
-	
     //Note: message_id_type :: u16
-    message_id : message_id_type = utils.to_type(message_data, message_id_type); //slice.reinterpret(client.data[:3], u32);
+    message_id : message_id_type = utils.to_type(recv_buffer_view(&current_bytes_recv), message_id_type);
+	unlock(&mutex);
 
-    if message_id in params.commands {
+    if index := params.command_index[message_id]; index != 0 {
         //Yes, a valid message
+        info : ^Command_info = &params.command_infos[index - 1];
         
         command : Command;
-
-		command.arena_alloc = new(mem_virtual.Arena);
-		err_a := mem_virtual.arena_init_growing(command.arena_alloc);
-		assert(err_a == nil);
-		command.alloc = mem_virtual.arena_allocator(command.arena_alloc);
+		counting := len(client.metrics.commands) != 0;
+		parse_start : time.Tick;
 
 		lock(&mutex);
-		did_parse_message := try_parse(client, params, message_id, &command, loc);
+		head_before := current_bytes_recv.head;
+		if counting {
+			parse_start = time.tick_now();
+		}
+		did_parse_message := try_parse(client, params, info, &command, loc);
+		parsed_bytes := current_bytes_recv.head - head_before;
+		if did_parse_message && recorder != nil {
+			//The bytes are still in the recive buffer (consuming does not move them).
+			record_message(recorder, connection_id, current_bytes_recv.data[head_before:][:parsed_bytes]);
+		}
 		unlock(&mutex);
 
+		if did_parse_message && counting {
+			metrics_record_in(client, info.index, parsed_bytes, time.tick_since(parse_start));
+		}
+
         if did_parse_message {      
-            //Add command to command queue.
+            //Add command to command queue, or hand it to the workers.
 			lock(&commands_mutex);
-            queue.append(&recv_commands, command);
 			defer unlock(&commands_mutex);
+			if d := intrinsics.atomic_load(&dispatcher); d != nil {
+				dispatcher_push(d, connection_id, command);
+			}
+			else {
+				queue.append(&recv_commands, command);
+				sync.cond_broadcast(&commands_cond);
+			}
 
             //fmt.printf("command : %v\n", command.id);
 
-            if command.value.id in params.command_allowing {
-                for new_command in params.command_allowing[command.value.id] {
-                    client.allowed_commands[new_command] = {};
-                }
+            for new_command in info.allowing {
+                command_bitset_set(client.allowed_commands, new_command, true);
             }
 
-            if command.value.id in params.command_disallowing {
-                for to_remove_command in params.command_disallowing[command.value.id] {
-                    builtin.delete_key(&client.allowed_commands, to_remove_command);
-                }
+            for to_remove_command in info.disallowing {
+                command_bitset_set(client.allowed_commands, to_remove_command, false);
             }
             
             return true;
         }
 
-		free_all(command.alloc);
-		mem_virtual.arena_destroy(command.arena_alloc);
-		free(command.arena_alloc);
+		destroy_command(command);
     }
     else {
         fmt.printf("A none valid message %v was passed.\n params are : %#v.\n", message_id);
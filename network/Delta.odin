@@ -0,0 +1,312 @@
+package network
+
+import "core:fmt"
+import "core:mem"
+import "core:reflect"
+import "core:time"
+
+import "../utils"
+
+import "../tracy"
+
+//Delta compression of (trivially copyable) state, the state is send as the difference from the last snapshot the client has acked.
+//The state is split into units (the fields, big fields are split into chunks), a bitmask says which units changed and only those are send.
+//Register Delta_message and Snapshot_ack in the commands map (and the state type, so both sides agree on the id).
+//The server keeps a Delta_encoder per client (and state type), the client keeps a Delta_decoder and answers every snapshot with a Snapshot_ack.
+
+Delta_chunk_size :: 32;		//Fields bigger then this are split into chunks of this size.
+Delta_history :: 32;		//The amount of snapshots kept as possible baselines.
+
+//The bytes a Delta_message adds on top of its bytes, when send (both message ids, the size header, the sequences and the array length).
+Delta_wire_overhead :: 2 * size_of(message_id_type) + size_of(utils.Header_size_type) + 2 * size_of(u32) + size_of(int);
+
+Delta_message :: struct {
+	message_id : message_id_type,	//The id of the state type
+	sequence : u32,
+	baseline : u32,					//The sequence this is a delta against, 0 is a zeroed state.
+	bytes : [dynamic]u8,			//The unit bitmask followed by the changed units.
+}
+
+Snapshot_ack :: struct {
+	message_id : message_id_type,
+	sequence : u32,
+}
+
+@(private)
+Delta_unit :: struct {
+	offset : int,
+	size : int,
+}
+
+//How a state type is split into units, this is computed once from the reflection field offsets.
+Delta_plan :: struct {
+	type : typeid,
+	size : int,
+	units : []Delta_unit,
+}
+
+@(private)
+Snapshot_ring :: struct {
+	sequences : [Delta_history]u32,	//0 if the slot is empty.
+	states : []u8,					//Delta_history states
+}
+
+Delta_encoder :: struct {
+	plan : Delta_plan,
+	message_id : message_id_type,
+	next_sequence : u32,
+	acked : u32,					//The newest sequence the client has acked, 0 if none.
+	history : Snapshot_ring,
+	message : Delta_message,		//Reused for every snapshot.
+
+	//Stats
+	snapshots : int,
+	raw_bytes : int,
+	encoded_bytes : int,
+	encode_time : time.Duration,
+}
+
+Delta_decoder :: struct {
+	plan : Delta_plan,
+	message_id : message_id_type,
+	latest : u32,					//The newest sequence decoded.
+	history : Snapshot_ring,
+	scratch : []u8,					//The state is decoded here and only copied to out if the message was valid.
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+make_delta_plan :: proc (type : typeid, loc := #caller_location) -> (plan : Delta_plan) {
+	fmt.assertf(utils.is_trivial_copied(type), "Only trivially copyable types can be delta compressed, %v is not", type, loc = loc);
+
+	plan.type = type;
+	plan.size = reflect.size_of_typeid(type);
+
+	units := make([dynamic]Delta_unit);
+
+	add_range :: proc (units : ^[dynamic]Delta_unit, offset, size : int) {
+		for o := 0; o < size; o += Delta_chunk_size {
+			append(units, Delta_unit{offset + o, min(Delta_chunk_size, size - o)});
+		}
+	}
+
+	if reflect.is_struct(type_info_of(type)) {
+		for f in reflect.struct_fields_zipped(type) {
+			if f.type.size != 0 {
+				add_range(&units, cast(int)f.offset, f.type.size);
+			}
+		}
+	}
+	else {
+		add_range(&units, 0, plan.size);
+	}
+
+	plan.units = units[:];
+	return;
+}
+
+delete_delta_plan :: proc (plan : ^Delta_plan) {
+	delete(plan.units);
+	plan^ = {};
+}
+
+delta_encoder_init :: proc (enc : ^Delta_encoder, params : Network_params, type : typeid, loc := #caller_location) {
+	fmt.assertf(type in params.commands_inverse, "The state %v must be in the commands map", type, loc = loc);
+	fmt.assertf(Delta_message in params.commands_inverse, "Delta_message must be in the commands map", loc = loc);
+
+	enc^ = {};
+	enc.plan = make_delta_plan(type, loc);
+	enc.message_id = params.commands_inverse[type];
+	enc.next_sequence = 1;
+	enc.history.states = make([]u8, Delta_history * enc.plan.size);
+	enc.message.bytes = make([dynamic]u8);
+}
+
+delta_encoder_destroy :: proc (enc : ^Delta_encoder) {
+	delete_delta_plan(&enc.plan);
+	delete(enc.history.states);
+	delete(enc.message.bytes);
+	enc^ = {};
+}
+
+//Encodes the state against the last acked snapshot, the returned message is valid until the next call.
+delta_encode :: proc (enc : ^Delta_encoder, state : any, loc := #caller_location) -> ^Delta_message {
+	tracy.Zone();
+	fmt.assertf(state.id == enc.plan.type, "Expected state %v, got %v", enc.plan.type, state.id, loc = loc);
+
+	start := time.tick_now();
+
+	current := mem.byte_slice(state.data, enc.plan.size);
+
+	baseline_seq : u32 = 0;
+	baseline : []u8 = nil;
+	if b, ok := _snapshot_ring_get(&enc.history, enc.plan.size, enc.acked); ok {
+		baseline_seq = enc.acked;
+		baseline = b;
+	}
+
+	sequence := enc.next_sequence;
+	enc.next_sequence += 1;
+	if enc.next_sequence == 0 {
+		enc.next_sequence = 1; //0 is reserved for the zeroed state.
+	}
+
+	enc.message.message_id = enc.message_id;
+	enc.message.sequence = sequence;
+	enc.message.baseline = baseline_seq;
+	_delta_diff(enc.plan, baseline, current, &enc.message.bytes);
+
+	_snapshot_ring_put(&enc.history, enc.plan.size, sequence, current);
+
+	enc.snapshots += 1;
+	enc.raw_bytes += enc.plan.size;
+	enc.encoded_bytes += len(enc.message.bytes) + Delta_wire_overhead;
+	enc.encode_time += time.tick_since(start);
+
+	return &enc.message;
+}
+
+//Call this when the client acks a snapshot, newer snapshots are then send as deltas against it.
+delta_encoder_ack :: proc (enc : ^Delta_encoder, ack : Snapshot_ack) {
+	if ack.message_id != enc.message_id {
+		return;
+	}
+	if enc.acked == 0 || udp_sequence_newer(ack.sequence, enc.acked) {
+		enc.acked = ack.sequence;
+	}
+}
+
+//The encoded size compared to the state size, below 1 is better.
+delta_compression_ratio :: proc (enc : Delta_encoder) -> f64 {
+	if enc.raw_bytes == 0 {
+		return 1;
+	}
+	return cast(f64)enc.encoded_bytes / cast(f64)enc.raw_bytes;
+}
+
+delta_decoder_init :: proc (dec : ^Delta_decoder, params : Network_params, type : typeid, loc := #caller_location) {
+	fmt.assertf(type in params.commands_inverse, "The state %v must be in the commands map", type, loc = loc);
+
+	dec^ = {};
+	dec.plan = make_delta_plan(type, loc);
+	dec.message_id = params.commands_inverse[type];
+	dec.history.states = make([]u8, Delta_history * dec.plan.size);
+	dec.scratch = make([]u8, dec.plan.size);
+}
+
+delta_decoder_destroy :: proc (dec : ^Delta_decoder) {
+	delete_delta_plan(&dec.plan);
+	delete(dec.history.states);
+	delete(dec.scratch);
+	dec^ = {};
+}
+
+//Writes the state into out, send the returned ack back to the server.
+//Returns false if the message is stale, malformed or the baseline is no longer known, out is then not changed.
+delta_decode :: proc (dec : ^Delta_decoder, msg : Delta_message, out : any, loc := #caller_location) -> (ack : Snapshot_ack, ok : bool) {
+	tracy.Zone();
+	fmt.assertf(out.id == dec.plan.type, "Expected state %v, got %v", dec.plan.type, out.id, loc = loc);
+
+	if msg.message_id != dec.message_id {
+		return {}, false;
+	}
+	if dec.latest != 0 && !udp_sequence_newer(msg.sequence, dec.latest) {
+		return {}, false;
+	}
+
+	baseline : []u8 = nil;
+	if msg.baseline != 0 {
+		baseline = _snapshot_ring_get(&dec.history, dec.plan.size, msg.baseline) or_return;
+	}
+
+	_delta_apply(dec.plan, baseline, msg.bytes[:], dec.scratch) or_return;
+
+	if dec.plan.size != 0 {
+		mem.copy(out.data, raw_data(dec.scratch), dec.plan.size);
+	}
+	_snapshot_ring_put(&dec.history, dec.plan.size, msg.sequence, dec.scratch);
+	dec.latest = msg.sequence;
+
+	return Snapshot_ack{dec.message_id, msg.sequence}, true;
+}
+
+//Encodes the state against what the client last acked and sends it as a Delta_message.
+send_message_delta :: proc (server : ^Server, client : ^Server_side_client, enc : ^Delta_encoder, state : any, loc := #caller_location) -> (err : bool) {
+	return send_message_server_client(server, client, delta_encode(enc, state, loc)^, loc);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+@(private)
+_snapshot_ring_get :: proc (ring : ^Snapshot_ring, size : int, sequence : u32) -> (state : []u8, ok : bool) {
+	if sequence == 0 {
+		return nil, false;
+	}
+	slot := cast(int)(sequence % Delta_history);
+	if ring.sequences[slot] != sequence {
+		return nil, false;
+	}
+	return ring.states[slot * size:][:size], true;
+}
+
+@(private)
+_snapshot_ring_put :: proc (ring : ^Snapshot_ring, size : int, sequence : u32, state : []u8) {
+	slot := cast(int)(sequence % Delta_history);
+	ring.sequences[slot] = sequence;
+	if size != 0 {
+		mem.copy(&ring.states[slot * size], raw_data(state), size);
+	}
+}
+
+//A nil baseline is a zeroed state.
+@(private)
+_delta_diff :: proc (plan : Delta_plan, baseline : []u8, current : []u8, out : ^[dynamic]u8) {
+	mask_size := (len(plan.units) + 7) / 8;
+
+	clear(out);
+	resize(out, mask_size);
+	mem.zero_slice(out[:]);
+
+	zeros : [Delta_chunk_size]u8;
+
+	for unit, i in plan.units {
+		cur := current[unit.offset:][:unit.size];
+		base := zeros[:unit.size] if baseline == nil else baseline[unit.offset:][:unit.size];
+
+		if mem.compare(cur, base) != 0 {
+			out[i / 8] |= 1 << cast(u8)(i % 8);
+			append(out, ..cur);
+		}
+	}
+}
+
+@(private)
+_delta_apply :: proc (plan : Delta_plan, baseline : []u8, bytes : []u8, dst : []u8) -> bool {
+	mask_size := (len(plan.units) + 7) / 8;
+	if len(bytes) < mask_size {
+		return false;
+	}
+
+	if baseline == nil {
+		mem.zero_slice(dst);
+	}
+	else {
+		copy(dst, baseline);
+	}
+
+	mask := bytes[:mask_size];
+	changed := bytes[mask_size:];
+
+	for unit, i in plan.units {
+		if mask[i / 8] & (1 << cast(u8)(i % 8)) == 0 {
+			continue;
+		}
+		if len(changed) < unit.size {
+			return false;
+		}
+		copy(dst[unit.offset:][:unit.size], changed[:unit.size]);
+		changed = changed[unit.size:];
+	}
+
+	return len(changed) == 0;
+}
@@ -0,0 +1,222 @@
+package network
+
+import "core:sync"
+
+import "base:intrinsics"
+
+import "core:container/queue"
+
+import "../utils"
+
+import "../tracy"
+
+//An optional dispatch mode for the server, parsed commands are handled as jobs on the shared job system (see utils/Jobs.odin) instead of being queued for the main thread.
+//The clients are sharded, a shard is only handled by one worker at a time and in order, so the commands of a client are handled in the order they arrived.
+//The handler can return a result, the results are passed back to the main thread through a lock-free queue, see pop_completion.
+
+//Called on a job worker (or a thread helping with jobs), with no server lock held. The command is destroyed after the handler returns, so copy what is needed.
+//The acceptor adds clients meanwhile, so a handler that uses server.clients (send_broadcast, send_broadcast_at, send_entity_update, disconnecting) must take server.clients_mutex itself.
+//The handler may disconnect the client it is handling, the arena pool the command is returned to is then kept until the command is destroyed.
+Dispatch_handler :: #type proc (server : ^Server, client_id : client_id_type, command : Command, user_data : rawptr) -> (result : rawptr);
+
+Completion :: struct {
+	client_id : client_id_type,
+	type : typeid,				//The type of the command that was handled.
+	result : rawptr,			//What the handler returned, it is never nil.
+}
+
+Dispatch_batch :: 64;			//The most commands a shard handles before it gives the worker to the next shard.
+Dispatch_completion_capacity :: 1 << 14;
+
+@(private)
+Dispatch_item :: struct {
+	client_id : client_id_type,
+	command : Command,
+}
+
+@(private)
+Dispatch_shard :: struct {
+	dispatcher : ^Dispatcher,
+	items : queue.Queue(Dispatch_item),
+	scheduled : bool,						//There is a job for this shard, locked by mutex
+	running_client : client_id_type,		//-1 when no command is being handled, locked by mutex
+	running : ^Dispatch_item,				//The item being handled, locked by mutex
+	dropped_pool : ^Arena_pool,				//The arena pool of the running client if it was dropped, freed after the command, locked by mutex
+	mutex : sync.Mutex,
+}
+
+Dispatcher :: struct {
+	server : ^Server,
+	handler : Dispatch_handler,
+	user_data : rawptr,
+
+	shards : []Dispatch_shard,
+	completions : utils.Mpmc_queue(Completion),
+	completions_dropped : int,				//atomic, results that did not fit because pop_completion was not called, they are lost.
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+//From here on commands from all (current and future) clients are handled by the handler on the job workers, instead of being put in recv_commands.
+//0 shards means 4 per job worker.
+start_dispatch :: proc (server : ^Server, handler : Dispatch_handler, user_data : rawptr = nil, shard_count := 0, loc := #caller_location) {
+	tracy.Zone();
+	assert(server.dispatcher == nil, "dispatch is already started", loc);
+
+	shards := shard_count;
+	if shards <= 0 {
+		shards = utils.jobs_worker_count() * 4;
+	}
+
+	d := new(Dispatcher);
+	d.server = server;
+	d.handler = handler;
+	d.user_data = user_data;
+	d.shards = make([]Dispatch_shard, shards);
+	for &s in d.shards {
+		s.dispatcher = d;
+		s.running_client = -1;
+		queue.init(&s.items);
+	}
+	utils.mpmc_init(&d.completions, Dispatch_completion_capacity);
+
+	lock(&server.clients_mutex);
+	defer unlock(&server.clients_mutex);
+
+	server.dispatcher = d;
+	for id, client in server.clients {
+		client.connection_id = id;
+		intrinsics.atomic_store(&client.dispatcher, d);
+	}
+}
+
+//Pops a result from the workers, call it on the main thread until it returns false.
+//If it is not called the queue fills up (Dispatch_completion_capacity) and the new results are lost, counted in completions_dropped.
+pop_completion :: proc (server : ^Server) -> (completion : Completion, ok : bool) {
+	d := server.dispatcher;
+	if d == nil {
+		return {}, false;
+	}
+
+	return utils.mpmc_pop(&d.completions);
+}
+
+//The clients must be disconnected first, the results that are not popped are lost.
+@(private)
+dispatcher_destroy :: proc (d : ^Dispatcher) {
+	tracy.Zone();
+
+	//Let the jobs finish what is queued, and help meanwhile.
+	for &s in d.shards {
+		for {
+			sync.lock(&s.mutex);
+			busy := s.scheduled;
+			sync.unlock(&s.mutex);
+			if !busy {
+				break;
+			}
+			if !utils.job_help() {
+				intrinsics.cpu_relax();
+			}
+		}
+		queue.destroy(&s.items);
+	}
+
+	utils.mpmc_destroy(&d.completions);
+	delete(d.shards);
+	free(d);
+}
+
+//Called from the recive threads instead of appending to recv_commands.
+@(private)
+dispatcher_push :: proc (d : ^Dispatcher, client_id : client_id_type, command : Command) {
+	shard := &d.shards[client_id % len(d.shards)];
+
+	sync.lock(&shard.mutex);
+	queue.append(&shard.items, Dispatch_item{client_id, command});
+	schedule := !shard.scheduled;
+	shard.scheduled = true;
+	sync.unlock(&shard.mutex);
+
+	if schedule {
+		utils.job_spawn(_shard_job, shard);
+	}
+}
+
+//Destroys the clients commands that are not handled yet, after this no command of the client is queued in the dispatcher.
+//It does not wait for a command that is being handled (the handler might be the one disconnecting the client), instead the clients arena pool is moved to the shard and freed when the handler returns.
+//A zero copy command keeps its recive block alive by itself.
+//Called from destroy_client_base with the clients locks held.
+@(private)
+dispatcher_drop_client :: proc (d : ^Dispatcher, client : ^Client_base) {
+	tracy.Zone();
+
+	client_id := client.connection_id;
+	shard := &d.shards[client_id % len(d.shards)];
+
+	sync.lock(&shard.mutex);
+	defer sync.unlock(&shard.mutex);
+
+	for _ in 0..<queue.len(shard.items) {
+		item := queue.pop_front(&shard.items);
+		if item.client_id == client_id {
+			destroy_command(item.command);
+		}
+		else {
+			queue.push_back(&shard.items, item);
+		}
+	}
+
+	if shard.running_client == client_id && shard.running != nil && shard.running.command.pool == &client.arena_pool {
+		dropped := new(Arena_pool);
+		dropped^ = client.arena_pool;
+		client.arena_pool = {};
+		shard.running.command.pool = dropped;
+		shard.dropped_pool = dropped;
+	}
+}
+
+//A job, handles up to Dispatch_batch commands of the shard and spawns itself again if there are more.
+@(private)
+_shard_job :: proc (data : rawptr) {
+	tracy.Zone();
+
+	shard := cast(^Dispatch_shard)data;
+	d := shard.dispatcher;
+
+	for _ in 0..<Dispatch_batch {
+		sync.lock(&shard.mutex);
+		if queue.len(shard.items) == 0 {
+			shard.scheduled = false;
+			sync.unlock(&shard.mutex);
+			return;
+		}
+		item := queue.pop_front(&shard.items);
+		shard.running_client = item.client_id;
+		shard.running = &item;
+		sync.unlock(&shard.mutex);
+
+		result := d.handler(d.server, item.client_id, item.command, d.user_data);
+		if result != nil {
+			if !utils.mpmc_push(&d.completions, Completion{item.client_id, item.command.value.id, result}) {
+				intrinsics.atomic_add(&d.completions_dropped, 1);
+			}
+		}
+
+		//The client might have been dropped while the handler ran, item.command is then returned to dropped_pool.
+		//The command is destroyed before running is cleared, else a drop in between would not move the pool the command is returned to.
+		sync.lock(&shard.mutex);
+		destroy_command(item.command);
+		if shard.dropped_pool != nil {
+			arena_pool_destroy(shard.dropped_pool);
+			free(shard.dropped_pool);
+			shard.dropped_pool = nil;
+		}
+		shard.running = nil;
+		shard.running_client = -1;
+		sync.unlock(&shard.mutex);
+	}
+
+	//Still scheduled, give the worker to the other shards and continue later.
+	utils.job_spawn(_shard_job, shard);
+}
@@ -0,0 +1,222 @@
+package network
+
+import "core:fmt"
+import "core:math"
+
+import "../utils"
+
+import "../tracy"
+
+//Spatial interest management, so an update is only send to the clients near it instead of to every client.
+//The world (the ground plane) is split into hashed cells, a client subscribes to the cells around it and updates are send to the subscribers of the cell they happen in.
+//Only the cells that enter or leave a clients area are touched when it moves, so the cost scales with movement and not with the size of the world.
+
+Interest_cell :: [2]i32;
+
+@(private)
+Interest_area :: struct {
+	min, max : Interest_cell,	//inclusive
+}
+
+Interest_grid :: struct {
+	cell_size : f32,
+	cells : map[Interest_cell][dynamic]client_id_type,		//The subscribers of each (non empty) cell.
+	areas : map[client_id_type]Interest_area,				//The cells each client is subscribed to.
+	entities : map[u64]Interest_cell,						//The cell each tagged entity is in.
+
+	mutex : utils.Mutex,
+
+	cells_changed : int,	//Stats, the amount of cell subscriptions added or removed.
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+interest_grid_init :: proc (grid : ^Interest_grid, cell_size : f32, loc := #caller_location) {
+	fmt.assertf(cell_size > 0, "cell_size must be positive, it is %v", cell_size, loc = loc);
+
+	grid^ = {};
+	grid.cell_size = cell_size;
+	grid.cells = make(map[Interest_cell][dynamic]client_id_type);
+	grid.areas = make(map[client_id_type]Interest_area);
+	grid.entities = make(map[u64]Interest_cell);
+}
+
+interest_grid_destroy :: proc (grid : ^Interest_grid) {
+	for _, subs in grid.cells {
+		delete(subs);
+	}
+	delete(grid.cells);
+	delete(grid.areas);
+	delete(grid.entities);
+	grid^ = {};
+}
+
+interest_cell_of :: #force_inline proc (grid : ^Interest_grid, position : [2]f32) -> Interest_cell {
+	return {cast(i32)math.floor(position.x / grid.cell_size), cast(i32)math.floor(position.y / grid.cell_size)};
+}
+
+//Subscribes the client to every cell within radius of position, call it again when the client moves (it is cheap if the cells did not change).
+interest_subscribe :: proc (grid : ^Interest_grid, client_id : client_id_type, position : [2]f32, radius : f32) {
+	tracy.Zone();
+
+	new_area := Interest_area{
+		interest_cell_of(grid, position - radius),
+		interest_cell_of(grid, position + radius),
+	};
+
+	lock(&grid.mutex);
+	defer unlock(&grid.mutex);
+
+	old_area, had_area := grid.areas[client_id];
+	if had_area && old_area == new_area {
+		return;
+	}
+
+	//Leave the cells that are no longer in the area.
+	if had_area {
+		for y in old_area.min.y..=old_area.max.y {
+			for x in old_area.min.x..=old_area.max.x {
+				if !_area_contains(new_area, {x, y}) {
+					_cell_remove(grid, {x, y}, client_id);
+				}
+			}
+		}
+	}
+
+	//Join the cells that are new.
+	for y in new_area.min.y..=new_area.max.y {
+		for x in new_area.min.x..=new_area.max.x {
+			if !had_area || !_area_contains(old_area, {x, y}) {
+				_, subs, _, _ := map_entry(&grid.cells, Interest_cell{x, y});
+				append(subs, client_id);
+				grid.cells_changed += 1;
+			}
+		}
+	}
+
+	grid.areas[client_id] = new_area;
+}
+
+//Call this when the client disconnects.
+interest_unsubscribe :: proc (grid : ^Interest_grid, client_id : client_id_type) {
+	tracy.Zone();
+
+	lock(&grid.mutex);
+	defer unlock(&grid.mutex);
+
+	area, had_area := grid.areas[client_id];
+	if !had_area {
+		return;
+	}
+
+	for y in area.min.y..=area.max.y {
+		for x in area.min.x..=area.max.x {
+			_cell_remove(grid, {x, y}, client_id);
+		}
+	}
+	delete_key(&grid.areas, client_id);
+}
+
+//Tags an entity with a position, so updates can be send with send_entity_update.
+interest_set_entity :: proc (grid : ^Interest_grid, entity : u64, position : [2]f32) {
+	lock(&grid.mutex);
+	defer unlock(&grid.mutex);
+
+	grid.entities[entity] = interest_cell_of(grid, position);
+}
+
+interest_remove_entity :: proc (grid : ^Interest_grid, entity : u64) {
+	lock(&grid.mutex);
+	defer unlock(&grid.mutex);
+
+	delete_key(&grid.entities, entity);
+}
+
+//The clients interested in the position, the result is allocated with alloc.
+interest_clients_at :: proc (grid : ^Interest_grid, position : [2]f32, alloc := context.temp_allocator) -> []client_id_type {
+	return _clients_in_cell(grid, interest_cell_of(grid, position), alloc);
+}
+
+//Sends the value to the clients interested in the position, it is encoded once.
+//Like send_broadcast, server.clients_mutex must be held by the caller.
+send_broadcast_at :: proc (server : ^Server, grid : ^Interest_grid, position : [2]f32, data : any, loc := #caller_location) {
+	tracy.Zone();
+	_send_to_cell(server, grid, interest_cell_of(grid, position), data, loc);
+}
+
+//Sends the value to the clients interested in the (tagged) entity, returns false if the entity is not tagged.
+//Like send_broadcast, server.clients_mutex must be held by the caller.
+send_entity_update :: proc (server : ^Server, grid : ^Interest_grid, entity : u64, data : any, loc := #caller_location) -> bool {
+	tracy.Zone();
+
+	lock(&grid.mutex);
+	cell, found := grid.entities[entity];
+	unlock(&grid.mutex);
+
+	if !found {
+		return false;
+	}
+
+	_send_to_cell(server, grid, cell, data, loc);
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+@(private)
+_area_contains :: #force_inline proc (area : Interest_area, cell : Interest_cell) -> bool {
+	return cell.x >= area.min.x && cell.x <= area.max.x && cell.y >= area.min.y && cell.y <= area.max.y;
+}
+
+//grid.mutex must be held.
+@(private)
+_cell_remove :: proc (grid : ^Interest_grid, cell : Interest_cell, client_id : client_id_type) {
+	subs, found := &grid.cells[cell];
+	if !found {
+		return;
+	}
+	for id, i in subs^ {
+		if id == client_id {
+			unordered_remove(subs, i);
+			grid.cells_changed += 1;
+			break;
+		}
+	}
+	if len(subs^) == 0 {
+		delete(subs^);
+		delete_key(&grid.cells, cell);
+	}
+}
+
+@(private)
+_clients_in_cell :: proc (grid : ^Interest_grid, cell : Interest_cell, alloc := context.temp_allocator) -> []client_id_type {
+	lock(&grid.mutex);
+	defer unlock(&grid.mutex);
+
+	subs, found := grid.cells[cell];
+	if !found {
+		return nil;
+	}
+	res := make([]client_id_type, len(subs), alloc);
+	copy(res, subs[:]);
+	return res;
+}
+
+@(private)
+_send_to_cell :: proc (server : ^Server, grid : ^Interest_grid, cell : Interest_cell, data : any, loc := #caller_location) {
+	subscribers := _clients_in_cell(grid, cell, context.temp_allocator);
+	if len(subscribers) == 0 {
+		return;
+	}
+
+	msg, err := make_shared_message(server.params, data, loc = loc);
+	fmt.assertf(err == .ok, "Failed to encode %v, err : %v", data.id, err, loc);
+	defer shared_message_release(msg);
+
+	//server.clients_mutex is held by the caller.
+	for id in subscribers {
+		if client, ok := server.clients[id]; ok {
+			_send_shared_to_client(server, client, msg);
+		}
+	}
+}
@@ -0,0 +1,235 @@
+package network
+
+import "core:fmt"
+import "core:strings"
+import "core:time"
+import "core:sync"
+
+import "base:intrinsics"
+
+import "core:container/queue"
+
+import "../utils"
+
+import "../tracy"
+
+//Traffic counters per connection and per command type, they are off by default, see enable_metrics.
+//Every connection counts its own traffic, on the server the counts are also added to a server wide aggregate.
+//Read them with client_metrics_snapshot and server_metrics_snapshot, or push them to tracy with server_metrics_plot.
+
+Command_counters :: struct {
+	messages_in : u64,
+	bytes_in : u64,
+	messages_out : u64,
+	bytes_out : u64,
+	parse_time : u64,			//nanoseconds
+}
+
+//The counters are updated atomically, from the recive and sending threads.
+Traffic_counters :: struct {
+	commands : []Command_counters,	//Indexed by command index, empty if metrics are off.
+}
+
+Command_metrics :: struct {
+	type : typeid,
+	using counters : Command_counters,
+}
+
+Metrics_snapshot :: struct {
+	commands : []Command_metrics,	//Only the commands with any traffic.
+	total : Command_counters,
+
+	//The current queue depths, for the server these are summed over all connections.
+	connections : int,
+	recv_buffer_bytes : int,		//Recived, but not yet parsed.
+	recv_commands : int,			//Parsed, but not yet handled.
+	send_queue_bytes : int,			//Waiting in the send queue.
+
+	//The deepest single connection (only for the server).
+	max_recv_buffer_bytes : int,
+	max_recv_commands : int,
+	max_send_queue_bytes : int,
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+//Metrics are off by default, enable them before passing the params to make_server or make_client.
+enable_metrics :: proc (params : ^Network_params) {
+	params.collect_metrics = true;
+}
+
+traffic_counters_init :: proc (counters : ^Traffic_counters, params : Network_params) {
+	if params.collect_metrics {
+		counters.commands = make([]Command_counters, len(params.command_infos));
+	}
+}
+
+traffic_counters_destroy :: proc (counters : ^Traffic_counters) {
+	delete(counters.commands);
+	counters.commands = nil;
+}
+
+//The counters and queue depths of a single connection, free with delete_metrics_snapshot.
+client_metrics_snapshot :: proc (client : ^Client_base, params : Network_params, alloc := context.allocator) -> (snapshot : Metrics_snapshot) {
+	tracy.Zone();
+
+	snapshot = _snapshot_counters(client.metrics, params, alloc);
+	snapshot.connections = 1;
+
+	recv_buffer, recv_commands, send_queue := _connection_depths(client);
+	snapshot.recv_buffer_bytes = recv_buffer;
+	snapshot.recv_commands = recv_commands;
+	snapshot.send_queue_bytes = send_queue;
+
+	return;
+}
+
+//The server wide counters and the queue depths summed over all connections, free with delete_metrics_snapshot.
+server_metrics_snapshot :: proc (server : ^Server, alloc := context.allocator) -> (snapshot : Metrics_snapshot) {
+	tracy.Zone();
+
+	snapshot = _snapshot_counters(server.metrics, server.params, alloc);
+
+	lock(&server.clients_mutex);
+	defer unlock(&server.clients_mutex);
+
+	for _, client in server.clients {
+		recv_buffer, recv_commands, send_queue := _connection_depths(client);
+
+		snapshot.connections += 1;
+		snapshot.recv_buffer_bytes += recv_buffer;
+		snapshot.recv_commands += recv_commands;
+		snapshot.send_queue_bytes += send_queue;
+		snapshot.max_recv_buffer_bytes = max(snapshot.max_recv_buffer_bytes, recv_buffer);
+		snapshot.max_recv_commands = max(snapshot.max_recv_commands, recv_commands);
+		snapshot.max_send_queue_bytes = max(snapshot.max_send_queue_bytes, send_queue);
+	}
+
+	return;
+}
+
+delete_metrics_snapshot :: proc (snapshot : Metrics_snapshot, alloc := context.allocator) {
+	delete(snapshot.commands, alloc);
+}
+
+//Pushes the server wide metrics as tracy plots, call it once per frame (it does nothing if tracy is disabled).
+server_metrics_plot :: proc (server : ^Server) {
+	when tracy.TRACY_ENABLE {
+		tracy.Zone();
+
+		snapshot := server_metrics_snapshot(server, context.temp_allocator);
+
+		tracy.PlotI("net connections", cast(i64)snapshot.connections);
+		tracy.PlotI("net messages in", cast(i64)snapshot.total.messages_in);
+		tracy.PlotI("net bytes in", cast(i64)snapshot.total.bytes_in);
+		tracy.PlotI("net messages out", cast(i64)snapshot.total.messages_out);
+		tracy.PlotI("net bytes out", cast(i64)snapshot.total.bytes_out);
+		tracy.PlotI("net recv buffer bytes", cast(i64)snapshot.recv_buffer_bytes);
+		tracy.PlotI("net recv commands", cast(i64)snapshot.recv_commands);
+		tracy.PlotI("net send queue bytes", cast(i64)snapshot.send_queue_bytes);
+
+		//Tracy keeps the plot names, so they are made once.
+		if server.plot_names == nil {
+			server.plot_names = make([][2]cstring, len(server.params.command_infos));
+			for info, i in server.params.command_infos {
+				server.plot_names[i] = {
+					strings.clone_to_cstring(fmt.tprintf("net %v bytes in", info.type)),
+					strings.clone_to_cstring(fmt.tprintf("net %v bytes out", info.type)),
+				};
+			}
+		}
+
+		for c in snapshot.commands {
+			names := server.plot_names[command_index_of(server.params, c.type)];
+			tracy.PlotI(names[0], cast(i64)c.bytes_in);
+			tracy.PlotI(names[1], cast(i64)c.bytes_out);
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+@(private)
+_count :: #force_inline proc (counter : ^Command_counters, bytes : int, is_in : bool, parse_time : time.Duration) {
+	if is_in {
+		intrinsics.atomic_add(&counter.messages_in, 1);
+		intrinsics.atomic_add(&counter.bytes_in, cast(u64)bytes);
+		intrinsics.atomic_add(&counter.parse_time, cast(u64)parse_time);
+	}
+	else {
+		intrinsics.atomic_add(&counter.messages_out, 1);
+		intrinsics.atomic_add(&counter.bytes_out, cast(u64)bytes);
+	}
+}
+
+//Counts a parsed message, bytes includes the message id.
+@(private)
+metrics_record_in :: proc (client : ^Client_base, index : command_index_type, bytes : int, parse_time : time.Duration) {
+	_count(&client.metrics.commands[index], bytes, true, parse_time);
+	if client.server_metrics != nil {
+		_count(&client.server_metrics.commands[index], bytes, true, parse_time);
+	}
+}
+
+//Counts an encoded message (it starts with the message id).
+@(private)
+metrics_record_out :: proc (client : ^Client_base, params : Network_params, encoded : []u8) {
+	if len(client.metrics.commands) == 0 || len(encoded) < size_of(message_id_type) {
+		return;
+	}
+	index := params.command_index[utils.to_type(encoded, message_id_type)];
+	if index == 0 {
+		return;
+	}
+	_count(&client.metrics.commands[index - 1], len(encoded), false, 0);
+	if client.server_metrics != nil {
+		_count(&client.server_metrics.commands[index - 1], len(encoded), false, 0);
+	}
+}
+
+@(private)
+_snapshot_counters :: proc (counters : Traffic_counters, params : Network_params, alloc := context.allocator) -> (snapshot : Metrics_snapshot) {
+	commands := make([dynamic]Command_metrics, 0, len(counters.commands), alloc);
+
+	for &c, i in counters.commands {
+		cur := Command_counters{
+			messages_in = intrinsics.atomic_load(&c.messages_in),
+			bytes_in = intrinsics.atomic_load(&c.bytes_in),
+			messages_out = intrinsics.atomic_load(&c.messages_out),
+			bytes_out = intrinsics.atomic_load(&c.bytes_out),
+			parse_time = intrinsics.atomic_load(&c.parse_time),
+		};
+
+		snapshot.total.messages_in += cur.messages_in;
+		snapshot.total.bytes_in += cur.bytes_in;
+		snapshot.total.messages_out += cur.messages_out;
+		snapshot.total.bytes_out += cur.bytes_out;
+		snapshot.total.parse_time += cur.parse_time;
+
+		if cur != {} {
+			append(&commands, Command_metrics{params.command_infos[i].type, cur});
+		}
+	}
+
+	snapshot.commands = commands[:];
+	return;
+}
+
+@(private)
+_connection_depths :: proc (client : ^Client_base) -> (recv_buffer, recv_commands, send_queue : int) {
+	lock(&client.mutex);
+	recv_buffer = recv_buffer_len(client.current_bytes_recv);
+	unlock(&client.mutex);
+
+	lock(&client.commands_mutex);
+	recv_commands = queue.len(client.recv_commands);
+	unlock(&client.commands_mutex);
+
+	if client.send_queue.writer != nil {
+		sync.lock(&client.send_queue.mutex);
+		send_queue = client.send_queue.queued_bytes;
+		sync.unlock(&client.send_queue.mutex);
+	}
+
+	return;
+}
@@ -0,0 +1,280 @@
+package network
+
+import "core:c"
+import "core:c/libc"
+import "core:fmt"
+import "core:os"
+
+import "core:container/queue"
+
+import "../utils"
+import thread "../utils" //TODO
+
+import "../tracy"
+
+Server_mode :: enum {
+	thread_per_client,	//One blocking recive thread per client.
+	reactor,			//All clients are multiplexed on a small fixed set of event loop threads (epoll), only on linux, other platforms fall back to thread_per_client.
+}
+
+Reactor_max_events	:: 256;
+Reactor_wait_ms		:: 50;		//How often the event loops check if they should close.
+Reactor_max_read	:: 256 * 1024;	//The most bytes read from one client per event, so a flooding client does not starve the others in its loop (epoll reports it again).
+
+Reactor_loop :: struct {
+	server : ^Server,
+	epoll_fd : c.int,
+	thread : ^thread.Thread,
+
+	clients : map[client_id_type]^Server_side_client,	//The clients registered in this loop, locked by mutex
+	mutex : utils.Mutex,								//Is held while a client is being read, so a client cannot be removed while it is being parsed.
+}
+
+Reactor :: struct {
+	loops : []Reactor_loop,
+	should_close : bool,
+}
+
+when ODIN_OS == .Linux {
+	foreign import libc_epoll "system:c"
+
+	when ODIN_ARCH == .amd64 {
+		@(private)
+		Epoll_event :: struct #packed {
+			events : u32,
+			data : u64,
+		}
+	}
+	else {
+		@(private)
+		Epoll_event :: struct {
+			events : u32,
+			data : u64,
+		}
+	}
+
+	@(private) EPOLLIN 			:: 0x001;
+	@(private) EPOLLERR 		:: 0x008;
+	@(private) EPOLLHUP 		:: 0x010;
+	@(private) EPOLLRDHUP 		:: 0x2000;
+	@(private) EPOLL_CTL_ADD 	:: 1;
+	@(private) EPOLL_CTL_DEL 	:: 2;
+	@(private) MSG_DONTWAIT 	:: 0x40;
+	@(private) EINTR 			:: 4;
+	@(private) EAGAIN 			:: 11;
+
+	@(default_calling_convention="c", private)
+	foreign libc_epoll {
+		@(link_name="epoll_create1")	_epoll_create1	:: proc(flags : c.int) -> c.int ---
+		@(link_name="epoll_ctl")		_epoll_ctl		:: proc(epfd : c.int, op : c.int, fd : c.int, event : ^Epoll_event) -> c.int ---
+		@(link_name="epoll_wait")		_epoll_wait		:: proc(epfd : c.int, events : [^]Epoll_event, maxevents : c.int, timeout : c.int) -> c.int ---
+		@(link_name="recv")				_recv			:: proc(fd : c.int, buf : rawptr, length : c.size_t, flags : c.int) -> c.ssize_t ---
+		@(link_name="close")			_close			:: proc(fd : c.int) -> c.int ---
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+//Returns false if the reactor is not supported on this platform.
+reactor_init :: proc (server : ^Server, thread_count : int) -> bool {
+	tracy.Zone();
+
+	when ODIN_OS == .Linux {
+
+		loop_cnt := thread_count;
+		if loop_cnt <= 0 {
+			loop_cnt = max(1, os.processor_core_count() / 2);
+		}
+
+		server.reactor.should_close = false;
+		server.reactor.loops = make([]Reactor_loop, loop_cnt);
+
+		for &loop, i in server.reactor.loops {
+			loop.server = server;
+			loop.epoll_fd = _epoll_create1(0);
+			fmt.assertf(loop.epoll_fd >= 0, "Failed to create epoll, errno : %v", libc.errno()^);
+			loop.clients = make(map[client_id_type]^Server_side_client);
+			loop.thread = thread.create(reactor_loop_proc, &loop, i);
+		}
+
+		for loop in server.reactor.loops {
+			thread.start(loop.thread);
+		}
+
+		fmt.printf("Started reactor with %i event loops\n", loop_cnt);
+
+		return true;
+	}
+	else {
+		return false;
+	}
+}
+
+//The clients must be removed before this is called.
+reactor_destroy :: proc (server : ^Server) {
+	tracy.Zone();
+
+	when ODIN_OS == .Linux {
+		server.reactor.should_close = true;
+
+		for &loop in server.reactor.loops {
+			thread.destroy(loop.thread); //joins, the loop wakes up at least every Reactor_wait_ms
+			free(loop.thread);
+			_close(loop.epoll_fd);
+			delete(loop.clients);
+		}
+	}
+
+	delete(server.reactor.loops);
+	server.reactor = {};
+}
+
+//Registers a newly accepted client, from here on the event loop revices and parses for it.
+reactor_add_client :: proc (server : ^Server, client : ^Server_side_client) {
+	tracy.Zone();
+
+	when ODIN_OS == .Linux {
+		loop := &server.reactor.loops[client.client_id % len(server.reactor.loops)];
+		client.reactor_loop = loop;
+
+		lock(&loop.mutex);
+		defer unlock(&loop.mutex);
+
+		loop.clients[client.client_id] = client;
+
+		event := Epoll_event{events = EPOLLIN | EPOLLRDHUP, data = cast(u64)client.client_id};
+		res := _epoll_ctl(loop.epoll_fd, EPOLL_CTL_ADD, cast(c.int)client.socket, &event);
+		fmt.assertf(res == 0, "Failed to add client to epoll, errno : %v", libc.errno()^);
+
+		client.is_open = true;
+	}
+	else {
+		unreachable();
+	}
+}
+
+//Stops the event loop from reciving for the client, it is safe to call more then once.
+//Waits for the event loop to finish parsing the client, if it is currently doing so.
+//Returns false if the client was not registered (anymore), if the connection was closed by the peer the loop already closed and queued it for cleanup.
+reactor_remove_client :: proc (client : ^Server_side_client) -> bool {
+	tracy.Zone();
+
+	when ODIN_OS == .Linux {
+		loop := client.reactor_loop;
+
+		lock(&loop.mutex);
+		defer unlock(&loop.mutex);
+
+		return _reactor_unregister(loop, client);
+	}
+	else {
+		return false;
+	}
+}
+
+when ODIN_OS == .Linux {
+
+	//loop.mutex must be held, returns false if it was not registered.
+	@(private)
+	_reactor_unregister :: proc (loop : ^Reactor_loop, client : ^Server_side_client) -> bool {
+		if client.client_id in loop.clients {
+			_epoll_ctl(loop.epoll_fd, EPOLL_CTL_DEL, cast(c.int)client.socket, nil);
+			delete_key(&loop.clients, client.client_id);
+			return true;
+		}
+		return false;
+	}
+
+	@(private)
+	reactor_loop_proc : thread.Thread_Proc : proc(t : ^thread.Thread) {
+		tracy.Zone();
+		tracy.SetThreadName("Server reactor loop");
+
+		loop : ^Reactor_loop = cast(^Reactor_loop)t.data;
+		server : ^Server = loop.server;
+
+		events : [Reactor_max_events]Epoll_event;
+
+		for !server.reactor.should_close {
+			event_cnt := _epoll_wait(loop.epoll_fd, raw_data(events[:]), len(events), Reactor_wait_ms);
+
+			if event_cnt < 0 {
+				if libc.errno()^ != EINTR {
+					fmt.printf("epoll_wait failed, errno : %v\n", libc.errno()^);
+				}
+				continue;
+			}
+
+			for e in events[:event_cnt] {
+				lock(&loop.mutex);
+				if client, found := loop.clients[cast(client_id_type)e.data]; found {
+					_reactor_read_client(loop, client, server.params);
+				}
+				unlock(&loop.mutex);
+			}
+
+			free_all(context.temp_allocator);
+		}
+	}
+
+	//Reads the socket (without blocking, up to Reactor_max_read) and parses everything recived, loop.mutex must be held.
+	@(private)
+	_reactor_read_client :: proc (loop : ^Reactor_loop, client : ^Server_side_client, params : Network_params) {
+		tracy.Zone();
+
+		read := 0;
+		for read < Reactor_max_read {
+			lock(&client.mutex);
+			tail_space := recv_buffer_reserve(&client.current_bytes_recv, Recv_chunk_size);
+			unlock(&client.mutex);
+
+			bytes_recv := _recv(cast(c.int)client.socket, raw_data(tail_space), cast(c.size_t)len(tail_space), MSG_DONTWAIT);
+
+			if bytes_recv > 0 {
+				lock(&client.mutex);
+				recv_buffer_commit(&client.current_bytes_recv, cast(int)bytes_recv);
+				unlock(&client.mutex);
+				read += cast(int)bytes_recv;
+
+				for parse_message(client, params) {}; //Parses all messages...
+				if client.should_close {
+					_reactor_drop_client(loop, client); //It send invalid data or its send queue overflowed.
+					return;
+				}
+				continue;
+			}
+
+			if bytes_recv < 0 {
+				errno := libc.errno()^;
+				if errno == EAGAIN {
+					return; //Nothing more to read for now.
+				}
+				if errno == EINTR {
+					continue;
+				}
+				fmt.printf("failed recv, errno : %v for client %v\n", errno, client.client_id);
+			}
+
+			//The connection was closed (or broke).
+			if !client.should_close {
+				fmt.printf("Warning : a connection was close without should_close being set true. Automagicly closing now\n client : %v\n", client.client_id);
+			}
+			client.should_close = true;
+			_reactor_drop_client(loop, client);
+			return;
+		}
+	}
+
+	//Like the recive thread does when it exits, we close and queue the client for cleanup, loop.mutex must be held.
+	@(private)
+	_reactor_drop_client :: proc (loop : ^Reactor_loop, client : ^Server_side_client) {
+		_reactor_unregister(loop, client);
+		_close(cast(c.int)client.socket);
+		destroy_client_base(client);
+
+		server := loop.server;
+		lock(&server.clean_mutex);
+		queue.append(&server.clients_to_clean, utils.Pair(int, ^Server_side_client){cast(int)client.client_id, client});
+		unlock(&server.clean_mutex);
+	}
+}
@@ -0,0 +1,270 @@
+package network
+
+import "core:fmt"
+import "core:net"
+import "core:os"
+import "core:time"
+
+import "../utils"
+
+import "../tracy"
+
+//Captures every message the server recives (per client, with a timestamp) into a file, so a session can be replayed against a server later.
+//The messages are stored exactly as they arrived, the id followed by the value as written by utils.serialize_to_bytes (or the raw bytes for trivial commands).
+//The file is a Session_file_header followed by records, each a Session_record_header and the message bytes.
+
+Session_magic	:: 0x434E5246;	//"FRNC"
+Session_version	:: 1;
+
+Recorder_flush_size :: 64 * 1024;
+
+Session_file_header :: struct #packed {
+	magic : u32,
+	version : u32,
+}
+
+Session_record_header :: struct #packed {
+	time : i64,			//nanoseconds since the recording started
+	client : u32,		//The client id on the recording server
+	size : u32,			//The size of the message bytes
+}
+
+Recorder :: struct {
+	file : os.Handle,
+	start : time.Tick,
+	buffer : [dynamic]u8,
+	closed : bool,
+	records : int,
+
+	mutex : utils.Mutex,
+}
+
+//A loaded session, the message bytes of the records point into data.
+Session :: struct {
+	records : []Session_record,
+	data : []u8,
+}
+
+Session_record :: struct {
+	time : time.Duration,
+	client : u32,
+	message : []u8,
+}
+
+Replay_stats :: struct {
+	messages : int,
+	bytes : int,
+	clients : int,
+	duration : time.Duration,
+}
+
+//The connections of a replay, they are kept open after the replay so the server does not drop what is unhandled, close with close_replay.
+Replay :: struct {
+	sockets : map[u32]net.TCP_Socket,	//Per recorded client id
+	stats : Replay_stats,
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+//Starts recording everything the server recives, from all current and future clients.
+start_recording :: proc (server : ^Server, path : string, loc := #caller_location) -> (ok : bool) {
+	tracy.Zone();
+	assert(server.recorder == nil, "the server is already recording", loc);
+
+	file, err := os.open(path, os.O_WRONLY | os.O_CREATE | os.O_TRUNC, 0o644);
+	if err != 0 {
+		fmt.printf("Failed to open %v for recording, err : %v\n", path, err);
+		return false;
+	}
+
+	recorder := new(Recorder);
+	recorder.file = file;
+	recorder.start = time.tick_now();
+	recorder.buffer = make([dynamic]u8, 0, Recorder_flush_size * 2);
+	utils.append_type_to_data(Session_file_header{Session_magic, Session_version}, &recorder.buffer);
+
+	lock(&server.clients_mutex);
+	defer unlock(&server.clients_mutex);
+
+	server.recorder = recorder;
+	for id, client in server.clients {
+		client.connection_id = id;
+		client.recorder = recorder;
+	}
+
+	return true;
+}
+
+//Flushes and closes the file, the recorder itself is freed by close_server (a recive thread might still hold it).
+stop_recording :: proc (server : ^Server) {
+	tracy.Zone();
+
+	recorder := server.recorder;
+	if recorder == nil {
+		return;
+	}
+
+	lock(&server.clients_mutex);
+	server.recorder = nil;
+	for _, client in server.clients {
+		client.recorder = nil;
+	}
+	unlock(&server.clients_mutex);
+
+	lock(&recorder.mutex);
+	defer unlock(&recorder.mutex);
+
+	_recorder_flush(recorder);
+	os.close(recorder.file);
+	recorder.closed = true;
+
+	append(&server.stopped_recorders, recorder);
+}
+
+//Called from the recive threads with the exact bytes of a parsed message.
+@(private)
+record_message :: proc (recorder : ^Recorder, client : client_id_type, message : []u8) {
+	tracy.Zone();
+
+	lock(&recorder.mutex);
+	defer unlock(&recorder.mutex);
+
+	if recorder.closed {
+		return;
+	}
+
+	header := Session_record_header{cast(i64)time.tick_since(recorder.start), cast(u32)client, cast(u32)len(message)};
+	utils.append_type_to_data(header, &recorder.buffer);
+	append(&recorder.buffer, ..message);
+	recorder.records += 1;
+
+	if len(recorder.buffer) >= Recorder_flush_size {
+		_recorder_flush(recorder);
+	}
+}
+
+@(private)
+_recorder_flush :: proc (recorder : ^Recorder) {
+	if len(recorder.buffer) == 0 {
+		return;
+	}
+	_, err := os.write(recorder.file, recorder.buffer[:]);
+	if err != 0 {
+		fmt.printf("Failed to write the recording, err : %v\n", err);
+	}
+	clear(&recorder.buffer);
+}
+
+@(private)
+_recorder_free :: proc (recorder : ^Recorder) {
+	delete(recorder.buffer);
+	free(recorder);
+}
+
+//Loads a recorded session, free it with delete_session.
+load_session :: proc (path : string, alloc := context.allocator) -> (session : Session, ok : bool) {
+	tracy.Zone();
+
+	data := os.read_entire_file_from_filename(path, alloc) or_return;
+
+	if len(data) < size_of(Session_file_header) {
+		delete(data, alloc);
+		return {}, false;
+	}
+	header := utils.to_type(data, Session_file_header);
+	if header.magic != Session_magic || header.version != Session_version {
+		fmt.printf("%v is not a session recording (or a different version)\n", path);
+		delete(data, alloc);
+		return {}, false;
+	}
+
+	records := make([dynamic]Session_record, alloc);
+	rest := data[size_of(Session_file_header):];
+	for len(rest) >= size_of(Session_record_header) {
+		r := utils.to_type(rest, Session_record_header);
+		rest = rest[size_of(Session_record_header):];
+		if len(rest) < cast(int)r.size {
+			break; //A truncated recording, we keep what is complete.
+		}
+		append(&records, Session_record{cast(time.Duration)r.time, r.client, rest[:r.size]});
+		rest = rest[r.size:];
+	}
+
+	return Session{records[:], data}, true;
+}
+
+delete_session :: proc (session : Session, alloc := context.allocator) {
+	delete(session.records, alloc);
+	delete(session.data, alloc);
+}
+
+//Sends the session to a server over loopback, every recorded client gets its own connection.
+//speed scales the recorded timing (2 is twice as fast), 0 sends as fast as possible.
+replay_session :: proc (replay : ^Replay, session : Session, endpoint : net.Endpoint, speed : f64 = 1) -> (ok : bool) {
+	tracy.Zone();
+
+	replay.stats = {};
+	if replay.sockets == nil {
+		replay.sockets = make(map[u32]net.TCP_Socket);
+	}
+	stats := &replay.stats;
+
+	for r in session.records {
+		if r.client in replay.sockets {
+			continue;
+		}
+		s, err := net.dial_tcp(endpoint);
+		if err != nil {
+			fmt.printf("Failed to connect for replay, err : %v\n", err);
+			return false;
+		}
+		replay.sockets[r.client] = s;
+	}
+	stats.clients = len(replay.sockets);
+
+	//Consecutive records of the same client (that are due) are send with one syscall.
+	batch := make([dynamic]u8);
+	defer delete(batch);
+
+	start := time.tick_now();
+	for i := 0; i < len(session.records); {
+		client := session.records[i].client;
+
+		if speed > 0 {
+			due := cast(time.Duration)(cast(f64)session.records[i].time / speed);
+			if wait := due - time.tick_since(start); wait > 0 {
+				time.accurate_sleep(wait);
+			}
+		}
+
+		clear(&batch);
+		for i < len(session.records) && session.records[i].client == client {
+			r := session.records[i];
+			if speed > 0 && cast(time.Duration)(cast(f64)r.time / speed) > time.tick_since(start) {
+				break;
+			}
+			append(&batch, ..r.message);
+			stats.messages += 1;
+			i += 1;
+		}
+
+		if len(batch) == 0 {
+			continue; //Woke up a little early.
+		}
+		if send_bytes(replay.sockets[client], batch[:]) {
+			return false;
+		}
+		stats.bytes += len(batch);
+	}
+	stats.duration = time.tick_since(start);
+
+	return true;
+}
+
+close_replay :: proc (replay : ^Replay) {
+	for _, s in replay.sockets {
+		net.close(s);
+	}
+	delete(replay.sockets);
+	replay^ = {};
+}
@@ -0,0 +1,146 @@
+package network
+
+import "core:mem"
+
+import "base:intrinsics"
+
+//The smallest amount of free space we ask for before calling recv, this is also the initial capacity.
+Recv_chunk_size :: 16384;
+
+//A contiguous growable byte ring, the unread bytes are allways laid out as one slice (data[head:tail]).
+//Bytes are recived directly into the tail and messages are parsed directly from the head, so nothing is copied byte by byte.
+Recv_buffer :: struct {
+	data : []u8,		//block.bytes
+	head : int,			//first unread byte
+	tail : int,			//one past the last written byte
+	allocator : mem.Allocator,
+
+	//Zero copy commands point directly into the block, while there are any the bytes are never moved and a full block is replaced by a new one.
+	block : ^Recv_block,
+}
+
+//The memory of a recive buffer, zero copy commands keep it alive after the buffer moved on to a new block or was destroyed.
+//It is freed by the last release, from any thread, so the allocator must be thread safe.
+Recv_block :: struct {
+	bytes : []u8,
+	refs : int,					//atomic, one for the buffer while it is the current block and one per view
+	allocator : mem.Allocator,
+}
+
+recv_buffer_init :: proc (using buf : ^Recv_buffer, capacity : int = Recv_chunk_size, alloc := context.allocator, loc := #caller_location) {
+	allocator = alloc;
+	block = _recv_block_make(capacity, allocator, loc);
+	data = block.bytes;
+	head = 0;
+	tail = 0;
+}
+
+//The views that are still outstanding stay valid, the block is freed when the last of them is released.
+recv_buffer_destroy :: proc (using buf : ^Recv_buffer, loc := #caller_location) {
+	if block != nil {
+		recv_buffer_release_view(block);
+	}
+	buf^ = {};
+}
+
+//The amount of unread bytes.
+recv_buffer_len :: #force_inline proc (using buf : Recv_buffer) -> int {
+	return tail - head;
+}
+
+//A view of all unread bytes, it is valid until the next call to recv_buffer_reserve or recv_buffer_append.
+recv_buffer_view :: #force_inline proc (using buf : ^Recv_buffer) -> []u8 {
+	return data[head:tail];
+}
+
+//Makes sure there is at least min_free bytes after the tail and returns that space, write into it and then call recv_buffer_commit.
+//The unread bytes are moved to the front before we grow, so the buffer only grows if the unread bytes does not fit.
+//While views are outstanding nothing is moved, instead the unread bytes are copied to a new block and the old one is freed by its last view.
+recv_buffer_reserve :: proc (using buf : ^Recv_buffer, min_free : int = Recv_chunk_size, loc := #caller_location) -> []u8 {
+
+	//Views are only retained on this thread, so if there are none now there will be none until we return.
+	has_views := intrinsics.atomic_load(&block.refs) != 1;
+
+	if !has_views && head == tail {
+		head = 0;
+		tail = 0;
+	}
+
+	if len(data) - tail >= min_free {
+		return data[tail:];
+	}
+
+	unread := tail - head;
+
+	if !has_views && len(data) - unread >= min_free {
+		//compact, move the unread bytes to the front
+		if unread != 0 && head != 0 {
+			mem.copy(&data[0], &data[head], unread);
+		}
+	}
+	else {
+		//grow (or move to a fresh block of the same size, when the old one is pinned by views)
+		new_cap := max(len(data) * 2, unread + min_free);
+		if has_views {
+			new_cap = max(len(data), unread + min_free);
+		}
+		new_block := _recv_block_make(new_cap, allocator, loc);
+		if unread != 0 {
+			mem.copy(&new_block.bytes[0], &data[head], unread);
+		}
+		recv_buffer_release_view(block);
+		block = new_block;
+		data = block.bytes;
+	}
+
+	head = 0;
+	tail = unread;
+
+	return data[tail:];
+}
+
+//Marks cnt bytes, written into the slice from recv_buffer_reserve, as recived.
+recv_buffer_commit :: #force_inline proc (using buf : ^Recv_buffer, cnt : int, loc := #caller_location) {
+	assert(tail + cnt <= len(data), "commited more bytes then was reserved", loc);
+	tail += cnt;
+}
+
+//Marks cnt bytes from the head as read.
+recv_buffer_consume :: #force_inline proc (using buf : ^Recv_buffer, cnt : int, loc := #caller_location) {
+	assert(cnt <= tail - head, "consumed more bytes then was recived", loc);
+	head += cnt;
+}
+
+//Marks a zero copy view into the unread bytes as handed out, the bytes stay in place until the returned block is passed to recv_buffer_release_view.
+//Must be called from the thread using the buffer.
+recv_buffer_retain_view :: #force_inline proc (using buf : ^Recv_buffer) -> ^Recv_block {
+	intrinsics.atomic_add(&block.refs, 1);
+	return block;
+}
+
+//Can be called from any thread, the block is freed if this was the last view and the buffer moved on.
+recv_buffer_release_view :: proc (block : ^Recv_block) {
+	if intrinsics.atomic_sub(&block.refs, 1) == 1 {
+		delete(block.bytes, block.allocator);
+		free(block, block.allocator);
+	}
+}
+
+@(private="file")
+_recv_block_make :: proc (capacity : int, alloc : mem.Allocator, loc := #caller_location) -> ^Recv_block {
+	block := new(Recv_block, alloc, loc);
+	block.bytes = make([]u8, capacity, alloc, loc);
+	block.refs = 1;
+	block.allocator = alloc;
+	return block;
+}
+
+//Copies bytes into the tail, used when the bytes does not come directly from a socket.
+recv_buffer_append :: proc (buf : ^Recv_buffer, bytes : []u8, loc := #caller_location) {
+	if len(bytes) == 0 {
+		return;
+	}
+	dst := recv_buffer_reserve(buf, len(bytes), loc);
+	mem.copy(&dst[0], raw_data(bytes), len(bytes));
+	recv_buffer_commit(buf, len(bytes), loc);
+}
@@ -0,0 +1,320 @@
+package network
+
+import "core:fmt"
+import "core:net"
+import "core:sync"
+
+import "core:container/queue"
+
+import thread "../utils" //TODO
+
+import "../tracy"
+
+Backpressure_policy :: enum {
+	block,				//The sender waits until the writer has flushed the queue below the high water mark.
+	drop_message,		//The new message is not queued.
+	drop_client,		//The queue is cleared and the client is marked should_close.
+}
+
+Send_queue_config :: struct {
+	high_water_bytes : int,		//The most bytes queued for a single connection, 0 means unlimited.
+	policy : Backpressure_policy,
+	max_coalesce_bytes : int,	//The most bytes gathered into a single send.
+}
+
+Default_send_queue_config :: Send_queue_config{
+	high_water_bytes = 4 * 1024 * 1024,
+	policy = .block,
+	max_coalesce_bytes = 64 * 1024,
+}
+
+//The outbound messages of a single connection, they are send by a Writer thread so the sender never blocks on the socket.
+Send_queue :: struct {
+	pending : queue.Queue(^Shared_message),
+	queued_bytes : int,
+	config : Send_queue_config,
+
+	socket : net.TCP_Socket,
+	writer : ^Writer,			//nil if send queues are not used for this connection.
+	in_dirty : bool,			//The queue is in the writers dirty list.
+	closed : bool,
+	dropped : bool,				//The high water mark was hit with the drop_client policy (or the socket failed).
+
+	mutex : sync.Mutex,
+	drained : sync.Cond,		//Signaled when the writer has sent something.
+
+	staging : [dynamic]u8,		//Only used by the writer, many small messages are copied into this and send with one syscall.
+}
+
+//Flushes dirty send queues, there is one per Server and one per Client (when send queues are enabled).
+Writer :: struct {
+	thread : ^thread.Thread,
+	dirty : [dynamic]^Send_queue,
+	batch : [dynamic]^Send_queue,	//Only used by the writer thread.
+	should_close : bool,
+
+	mutex : sync.Mutex,				//Locks dirty and should_close
+	wake : sync.Cond,
+	flush_mutex : sync.Mutex,		//Held while a batch is flushed, so a queue can be destroyed safely.
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+//Send queues are off by default, enable them before passing the params to make_server or make_client.
+enable_send_queues :: proc (params : ^Network_params, config := Default_send_queue_config) {
+	params.use_send_queues = true;
+	params.send_queue_config = config;
+}
+
+writer_start :: proc (writer : ^Writer) {
+	tracy.Zone();
+
+	writer^ = {};
+	writer.dirty = make([dynamic]^Send_queue);
+	writer.batch = make([dynamic]^Send_queue);
+
+	writer_loop : thread.Thread_Proc : proc(t : ^thread.Thread) {
+		tracy.Zone();
+		tracy.SetThreadName("Network writer");
+
+		writer : ^Writer = cast(^Writer)t.data;
+
+		for {
+			sync.lock(&writer.mutex);
+			for len(writer.dirty) == 0 && !writer.should_close {
+				sync.cond_wait(&writer.wake, &writer.mutex);
+			}
+			if len(writer.dirty) == 0 && writer.should_close {
+				sync.unlock(&writer.mutex);
+				break;
+			}
+			writer.dirty, writer.batch = writer.batch, writer.dirty;
+			sync.lock(&writer.flush_mutex); //Taken before mutex is released, so send_queue_destroy cannot slip in between.
+			sync.unlock(&writer.mutex);
+
+			for q in writer.batch {
+				send_queue_flush(q);
+			}
+			clear(&writer.batch);
+			sync.unlock(&writer.flush_mutex);
+
+			free_all(context.temp_allocator);
+		}
+	}
+
+	writer.thread = thread.create(writer_loop, writer);
+	thread.start(writer.thread);
+}
+
+//All send queues using the writer must be destroyed first.
+writer_destroy :: proc (writer : ^Writer) {
+	tracy.Zone();
+
+	sync.lock(&writer.mutex);
+	writer.should_close = true;
+	sync.cond_signal(&writer.wake);
+	sync.unlock(&writer.mutex);
+
+	thread.destroy(writer.thread);
+	free(writer.thread);
+
+	delete(writer.dirty);
+	delete(writer.batch);
+}
+
+@(private)
+writer_mark_dirty :: proc (writer : ^Writer, q : ^Send_queue) {
+	sync.lock(&writer.mutex);
+	append(&writer.dirty, q);
+	sync.cond_signal(&writer.wake);
+	sync.unlock(&writer.mutex);
+}
+
+send_queue_init :: proc (q : ^Send_queue, socket : net.TCP_Socket, writer : ^Writer, config : Send_queue_config) {
+	queue.init(&q.pending);
+	q.socket = socket;
+	q.staging = make([dynamic]u8, 0, config.max_coalesce_bytes);
+	q.writer = writer;
+	q.config = config;
+}
+
+//Sends what is left (on the calling thread, if flush_remaining) and frees the queue, call this before the socket is closed.
+send_queue_destroy :: proc (q : ^Send_queue, flush_remaining := true) {
+	tracy.Zone();
+
+	if q.writer == nil {
+		return;
+	}
+
+	sync.lock(&q.mutex);
+	q.closed = true;
+	sync.cond_broadcast(&q.drained);
+	sync.unlock(&q.mutex);
+
+	//Make sure the writer is not holding the queue.
+	sync.lock(&q.writer.mutex);
+	for d, i in q.writer.dirty {
+		if d == q {
+			unordered_remove(&q.writer.dirty, i);
+			break;
+		}
+	}
+	sync.unlock(&q.writer.mutex);
+	sync.lock(&q.writer.flush_mutex);
+	sync.unlock(&q.writer.flush_mutex);
+
+	for queue.len(q.pending) != 0 {
+		msg := queue.pop_front(&q.pending);
+		if flush_remaining && !q.dropped {
+			send_bytes(q.socket, msg.data);
+		}
+		shared_message_release(msg);
+	}
+
+	queue.destroy(&q.pending);
+	delete(q.staging);
+	q.writer = nil;
+}
+
+//Queues the message for sending, the queue takes its own reference.
+//Returns true if the message was not queued, because of the high water mark or because the queue is closed.
+send_queue_push :: proc (q : ^Send_queue, msg : ^Shared_message) -> (err : bool) {
+	tracy.Zone();
+	assert(q.writer != nil, "send queues are not enabled for this connection");
+
+	sync.lock(&q.mutex);
+
+	if q.closed || q.dropped {
+		sync.unlock(&q.mutex);
+		return true;
+	}
+
+	if q.config.high_water_bytes > 0 && q.queued_bytes + len(msg.data) > q.config.high_water_bytes {
+		switch q.config.policy {
+			case .block:
+				//A single message bigger then the high water mark is allowed into an empty queue.
+				for q.queued_bytes != 0 && q.queued_bytes + len(msg.data) > q.config.high_water_bytes && !q.closed && !q.dropped {
+					sync.cond_wait(&q.drained, &q.mutex);
+				}
+				if q.closed || q.dropped {
+					sync.unlock(&q.mutex);
+					return true;
+				}
+			case .drop_message:
+				sync.unlock(&q.mutex);
+				return true;
+			case .drop_client:
+				_send_queue_clear(q);
+				q.dropped = true;
+				sync.unlock(&q.mutex);
+				return true;
+		}
+	}
+
+	shared_message_retain(msg);
+	queue.push_back(&q.pending, msg);
+	q.queued_bytes += len(msg.data);
+
+	mark := !q.in_dirty;
+	q.in_dirty = true;
+	sync.unlock(&q.mutex);
+
+	if mark {
+		writer_mark_dirty(q.writer, q);
+	}
+
+	return false;
+}
+
+//Called by the writer thread, gathers the pending messages into as few sends as possible.
+@(private)
+send_queue_flush :: proc (q : ^Send_queue) {
+	tracy.Zone();
+
+	for {
+		sync.lock(&q.mutex);
+		if q.closed || q.dropped || queue.len(q.pending) == 0 {
+			q.in_dirty = false;
+			sync.unlock(&q.mutex);
+			return;
+		}
+
+		//Gather as many messages as fits, they stay in the queue (and referenced) until they are sent, only the writer pops.
+		msg_cnt := 0;
+		total := 0;
+		clear(&q.staging);
+		for msg_cnt < queue.len(q.pending) {
+			data := queue.get(&q.pending, msg_cnt).data;
+			if msg_cnt != 0 && total + len(data) > q.config.max_coalesce_bytes {
+				break;
+			}
+			if total + len(data) <= q.config.max_coalesce_bytes {
+				append(&q.staging, ..data);
+			}
+			total += len(data);
+			msg_cnt += 1;
+		}
+
+		to_send : []u8 = q.staging[:];
+		big_msg : ^Shared_message;
+		if len(q.staging) != total {
+			//A single message bigger then max_coalesce_bytes is send without copying, it is kept alive even if the queue is cleared meanwhile.
+			big_msg = queue.get(&q.pending, 0);
+			shared_message_retain(big_msg);
+			to_send = big_msg.data;
+		}
+		sync.unlock(&q.mutex);
+
+		failed := send_bytes(q.socket, to_send);
+
+		if big_msg != nil {
+			shared_message_release(big_msg);
+		}
+
+		sync.lock(&q.mutex);
+		if !q.dropped { //If the client was dropped meanwhile the queue is allready cleared.
+			for _ in 0..<msg_cnt {
+				shared_message_release(queue.pop_front(&q.pending));
+			}
+			q.queued_bytes -= total;
+		}
+		if failed {
+			_send_queue_clear(q);
+			q.dropped = true;
+		}
+		sync.cond_broadcast(&q.drained);
+		sync.unlock(&q.mutex);
+	}
+}
+
+//q.mutex must be held.
+@(private)
+_send_queue_clear :: proc (q : ^Send_queue) {
+	for queue.len(q.pending) != 0 {
+		shared_message_release(queue.pop_front(&q.pending));
+	}
+	q.queued_bytes = 0;
+	sync.cond_broadcast(&q.drained);
+}
+
+//Encodes the message and puts it in the clients send queue, returns true if the message was not queued.
+//With the drop_client policy the client is marked should_close when its queue overflows.
+queue_message :: proc (client : ^Client_base, params : Network_params, data : any, loc := #caller_location) -> (err : bool) {
+	tracy.Zone();
+
+	msg, s_err := make_shared_message(params, data, loc = loc);
+	fmt.assertf(s_err == .ok, "Failed to encode %v, err : %v", data.id, s_err, loc);
+	defer shared_message_release(msg);
+
+	metrics_record_out(client, params, msg.data);
+	return queue_shared_message(client, msg);
+}
+
+queue_shared_message :: proc (client : ^Client_base, msg : ^Shared_message) -> (err : bool) {
+	err = send_queue_push(&client.send_queue, msg);
+	if err && client.send_queue.dropped && !client.should_close {
+		fmt.printf("Warning : the send queue went above the high water mark, dropping client\n");
+		client.should_close = true;
+	}
+	return err;
+}
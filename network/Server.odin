@@ -24,6 +24,7 @@ Server_side_client :: struct {
 
     //Network
     endpoint : net.Endpoint,
+    reactor_loop : ^Reactor_loop,               //nil when the client has its own recive_thread
 
     //ID
     client_id : client_id_type
@@ -50,6 +51,17 @@ Server :: struct {
     is_open : bool,
     should_close : bool,
     acceptor_thread : ^thread.Thread,
+    mode : Server_mode,
+    reactor : Reactor,                                  //Only used when mode is .reactor
+    writer : Writer,                                    //Only used when params.use_send_queues
+
+    //Only used when params.collect_metrics
+    metrics : Traffic_counters,                         //The aggregate of all connections.
+    plot_names : [][2]cstring,                          //The tracy plot names per command, see server_metrics_plot
+
+    recorder : ^Recorder,                               //Only set while recording, see start_recording
+    dispatcher : ^Dispatcher,                           //Only set in dispatch mode, see start_dispatch
+    stopped_recorders : [dynamic]^Recorder,             //Freed when the server closes.
  
     params : Network_params,
 }
@@ -62,7 +74,8 @@ Server_and_client :: struct {
 
 /////////////////////////////////////////////////////////////////////////////////////
 
-make_server :: proc(server : ^Server, params : Network_params, endpoint : net.Endpoint, loc := #caller_location) {
+//reactor_threads is the amount of event loops when mode is .reactor, 0 means half the core count.
+make_server :: proc(server : ^Server, params : Network_params, endpoint : net.Endpoint, mode := Server_mode.thread_per_client, reactor_threads := 0, loc := #caller_location) {
     tracy.Zone();
 
     assert(params.is_init, "network must be initialized before calling server_main", loc);
@@ -70,7 +83,17 @@ make_server :: proc(server : ^Server, params : Network_params, endpoint : net.En
     server^ = Server{
         endpoint = endpoint,
         params = params,
+        mode = mode,
+    }
+
+    if params.use_send_queues {
+        writer_start(&server.writer);
+    }
+    traffic_counters_init(&server.metrics, params);
 
+    if mode == .reactor && !reactor_init(server, reactor_threads) {
+        fmt.printf("Warning : the reactor server mode is not supported on this platform, falling back to one thread per client\n");
+        server.mode = .thread_per_client;
     }
 
 	queue.init(&server.dead_clients);
@@ -161,22 +184,32 @@ start_accepting :: proc (using server : ^Server, loc := #caller_location) {
             current_client_index += 1;
             
             /////////// setup client thread ///////////
-            assert(net.set_blocking(new_client.socket, true) == nil); //We want it to be blocking, since we have 1 thread per client.
+            assert(net.set_blocking(new_client.socket, true) == nil); //We want it to be blocking, since we have 1 thread per client (the reactor reads with MSG_DONTWAIT).
             //TODO a timeout is needed (and maybe keep alive settings?)
 			
-			sac := new(Server_and_client);
-           	sac.c = new_client;
-			sac.s = server;
+            if mode == .thread_per_client {
+                sac := new(Server_and_client);
+                sac.c = new_client;
+                sac.s = server;
 
-            new_client.recive_thread = thread.create(server_side_client_recive_loop, sac, client_index);
+                new_client.recive_thread = thread.create(server_side_client_recive_loop, sac, client_index);
+            }
             new_client.client_id = client_index;
 
-            queue.init(&new_client.current_bytes_recv);
+            recv_buffer_init(&new_client.current_bytes_recv);
+            arena_pool_init(&new_client.arena_pool);
+            if params.use_send_queues {
+                send_queue_init(&new_client.send_queue, new_client.socket, &writer, params.send_queue_config);
+            }
             queue.init(&new_client.recv_commands);
-            new_client.allowed_commands = make(typeid_set);
-            for k, v in params.initial_allowed_commands {
-                new_client.allowed_commands[k] = v;
+            new_client.allowed_commands = make_allowed_commands(params);
+            traffic_counters_init(&new_client.metrics, params);
+            if params.collect_metrics {
+                new_client.server_metrics = &server.metrics;
             }
+            new_client.connection_id = client_index;
+            new_client.recorder = recorder;
+            new_client.dispatcher = dispatcher;
             
             /////////// add the clients ///////////
             clients[client_index] = new_client;
@@ -187,7 +220,12 @@ start_accepting :: proc (using server : ^Server, loc := #caller_location) {
             unlock(&clients_mutex);
             fmt.printf("acceptor_loop unlocked clients_mutex %v\n", clients_mutex);
 
-            thread.start(new_client.recive_thread); 
+            if mode == .reactor {
+                reactor_add_client(server, new_client);
+            }
+            else {
+                thread.start(new_client.recive_thread); 
+            }
 
 			free_all(context.temp_allocator);
         }
@@ -266,9 +304,35 @@ close_server :: proc(using server : ^Server) {
     unlock(&clients_mutex);
     //fmt.printf("close_server 2 unlocked clients_mutex %v\n", clients_mutex);
 
+	if mode == .reactor {
+		reactor_destroy(server);
+	}
+
+	if params.use_send_queues {
+		writer_destroy(&writer);
+	}
+
 	_clean_clients(server);
 	queue.destroy(&clients_to_clean);
 
+	if dispatcher != nil {
+		dispatcher_destroy(dispatcher);
+		dispatcher = nil;
+	}
+
+	stop_recording(server);
+	for r in stopped_recorders {
+		_recorder_free(r);
+	}
+	delete(stopped_recorders);
+
+	traffic_counters_destroy(&metrics);
+	for names in plot_names {
+		delete(names[0]);
+		delete(names[1]);
+	}
+	delete(plot_names);
+
 	//TODO we want to handle the dead clients here???
 
 	queue.destroy(&dead_clients);
@@ -276,10 +340,41 @@ close_server :: proc(using server : ^Server) {
     fmt.printf("All clients disconnected\n");
 }
 
-send_broadcast :: proc (server : ^Server data : any, loc := #caller_location) {
+//Returns true if the client should recive the broadcast.
+Broadcast_filter :: #type proc(client : ^Server_side_client, user_data : rawptr) -> bool;
+
+//The value is encoded once and the same bytes are send to every client (that passes the filter if given).
+//server.clients_mutex must be held by the caller, nothing takes it for you (a Dispatch_handler does not have it either).
+send_broadcast :: proc (server : ^Server, data : any, filter : Broadcast_filter = nil, user_data : rawptr = nil, loc := #caller_location) {
 	tracy.Zone();
-    for _, client  in server.clients {
-        send_message(client.socket, server.params, data, loc);
+
+	msg, err := make_shared_message(server.params, data, loc = loc);
+	fmt.assertf(err == .ok, "Failed to encode broadcast %v, err : %v", data.id, err, loc);
+	defer shared_message_release(msg);
+
+	send_shared_message(server, msg, filter, user_data);
+}
+
+//Sends an already encoded message to every client (that passes the filter if given), server.clients_mutex must be held by the caller.
+send_shared_message :: proc (server : ^Server, msg : ^Shared_message, filter : Broadcast_filter = nil, user_data : rawptr = nil) {
+	tracy.Zone();
+
+    for _, client in server.clients {
+        if filter != nil && !filter(client, user_data) {
+            continue;
+        }
+        _send_shared_to_client(server, client, msg);
+    }
+}
+
+@(private)
+_send_shared_to_client :: proc (server : ^Server, client : ^Server_side_client, msg : ^Shared_message) {
+    metrics_record_out(client, server.params, msg.data);
+    if server.params.use_send_queues {
+        queue_shared_message(client, msg);
+    }
+    else {
+        send_bytes(client.socket, msg.data);
     }
 }
 
@@ -295,7 +390,7 @@ remove_client :: proc(server : ^Server, client : int) {
 }
 
 //both Server and client shall be locked when calling this.
-disconnect_client_server_size :: proc (using server : ^Server client_id : client_id_type, loc := #caller_location) {
+disconnect_client_server_size :: proc (using server : ^Server, client_id : client_id_type, loc := #caller_location) {
     tracy.Zone();
 
     c, f := server.clients[client_id];
@@ -307,10 +402,27 @@ disconnect_client_server_size :: proc (using server : ^Server client_id : client
     //fmt.printf("client is open, and we can now close it : %v\n", i);
     
     fmt.printf("disconnecting index %v at endpoint %v\n", client_id, c.endpoint);
-    net.close(c.socket);
 
-    thread.destroy(c.recive_thread, loc);
-	free(c.recive_thread);
+    //Whatever is still queued is send before the socket is closed.
+    send_queue_destroy(&c.send_queue);
+
+    if c.reactor_loop != nil {
+        //There is no recive thread to clean up after itself, so we do it here (unless the loop already did because the peer closed).
+        if reactor_remove_client(c) {
+            net.close(c.socket);
+            destroy_client_base(c);
+
+            lock(&server.clean_mutex);
+            queue.append(&server.clients_to_clean, utils.Pair(int, ^Server_side_client){client_id, c});
+            unlock(&server.clean_mutex);
+        }
+    }
+    else {
+        net.close(c.socket);
+
+        thread.destroy(c.recive_thread, loc);
+        free(c.recive_thread);
+    }
 
     fmt.printf("Terminated client with index %v\n", client_id);
 }
@@ -2,10 +2,17 @@ package network
 
 import "core:fmt"
 import "core:net"
+import "core:os"
 import "core:testing"
 import "core:time"
 
 import "core:container/queue"
+import "core:mem"
+import "core:reflect"
+import "core:slice"
+import "base:intrinsics"
+
+import mem_virtual "core:mem/virtual"
 
 import "../utils"
 import thread "../utils" //TODO
@@ -221,6 +228,1367 @@ test_main :: proc (t : ^testing.T) {
     }
 }
 
+//Appends the wire representation of a message to stream, the same bytes send_message would send.
+@(private)
+append_test_message :: proc (stream : ^[dynamic]u8, params : Network_params, value : any) {
+	id : message_id_type = params.commands_inverse[value.id];
+	utils.append_type_to_data(id, stream);
+	if utils.is_trivial_copied(value.id) {
+		utils.append_type_to_data(value, stream);
+	}
+	else {
+		utils.serialize_to_bytes(value, stream);
+	}
+}
+
+//Sets up a client base for parsing without a socket.
+@(private)
+init_test_client_base :: proc (client : ^Client_base, params : Network_params) {
+	recv_buffer_init(&client.current_bytes_recv);
+	arena_pool_init(&client.arena_pool);
+	queue.init(&client.recv_commands);
+	client.allowed_commands = make_allowed_commands(params);
+	traffic_counters_init(&client.metrics, params);
+}
+
+//Meassures how many bytes a single recive thread can parse, the old per byte queue path against the recive ring.
+@test
+bench_recv_parse :: proc (t : ^testing.T) {
+
+	Position :: struct { entity : u32, pos : [3]f32, vel : [3]f32 };
+	Chat_message :: struct { text : string };
+
+	Message_count :: 200_000;
+
+	commands_map : map[message_id_type]typeid = {
+		1 = Position,
+		2 = Chat_message,
+	};
+	defer delete(commands_map);
+	allowed : typeid_set = { Position = {}, Chat_message = {} };
+	defer delete(allowed);
+	no_list : map[typeid][]typeid;
+
+	params := make_params(proc(to_clean : any) {}, commands_map, allowed, no_list, no_list);
+	defer delete_params(&params);
+
+	stream := make([dynamic]u8);
+	defer delete(stream);
+	for i in 0..<Message_count {
+		if i % 8 == 0 {
+			append_test_message(&stream, params, Chat_message{"A typical chat message of a typical length"});
+		}
+		else {
+			append_test_message(&stream, params, Position{u32(i), {1, 2, 3}, {4, 5, 6}});
+		}
+	}
+
+	/////////// Before : one queue operation per byte ///////////
+	legacy_parsed := 0;
+	legacy_timer : time.Stopwatch;
+	time.stopwatch_start(&legacy_timer);
+	{
+		q : queue.Queue(u8);
+		queue.init(&q);
+		defer queue.destroy(&q);
+
+		for offset := 0; offset < len(stream); offset += Recv_chunk_size {
+			for d in stream[offset:min(offset + Recv_chunk_size, len(stream))] {
+				queue.append(&q, d);
+			}
+
+			for queue.len(q) >= size_of(message_id_type) {
+				id_data : [size_of(message_id_type)]u8;
+				for i in 0..<size_of(message_id_type) {
+					id_data[i] = queue.get(&q, i);
+				}
+				message_typeid := params.commands[utils.to_type(id_data[:], message_id_type)];
+
+				arena := new(mem_virtual.Arena);
+				assert(mem_virtual.arena_init_growing(arena) == nil);
+				alloc := mem_virtual.arena_allocator(arena);
+				done := false;
+
+				if utils.is_trivial_copied(message_typeid) {
+					size := reflect.size_of_typeid(message_typeid);
+					total := size_of(message_id_type) + size;
+					if queue.len(q) >= total {
+						data, _ := mem.alloc_bytes(size, allocator = alloc);
+						for i in 0..<size {
+							data[i] = queue.get(&q, i + size_of(message_id_type));
+						}
+						queue.consume_front(&q, total);
+						done = true;
+					}
+				}
+				else if queue.len(q) >= size_of(message_id_type) + size_of(utils.Header_size_type) {
+					header : [size_of(utils.Header_size_type)]u8;
+					for i in 0..<size_of(utils.Header_size_type) {
+						header[i] = queue.get(&q, i + size_of(message_id_type));
+					}
+					size := cast(int)utils.to_type(header[:], utils.Header_size_type);
+					total := size_of(message_id_type) + size;
+					if queue.len(q) >= total {
+						data := make([]u8, size);
+						for i in 0..<size {
+							data[i] = queue.get(&q, i + size_of(message_id_type));
+						}
+						queue.consume_front(&q, total);
+						_, err := utils.deserialize_from_bytes(message_typeid, data, alloc);
+						assert(err == .ok);
+						delete(data);
+						done = true;
+					}
+				}
+
+				mem_virtual.arena_destroy(arena);
+				free(arena);
+
+				if !done {
+					break;
+				}
+				legacy_parsed += 1;
+			}
+		}
+	}
+	time.stopwatch_stop(&legacy_timer);
+
+	/////////// After : bulk copy into the ring and parse from views ///////////
+	ring_parsed := 0;
+	ring_timer : time.Stopwatch;
+	time.stopwatch_start(&ring_timer);
+	{
+		client : Client_base;
+		init_test_client_base(&client, params);
+		defer destroy_client_base(&client);
+
+		for offset := 0; offset < len(stream); offset += Recv_chunk_size {
+			recv_buffer_append(&client.current_bytes_recv, stream[offset:min(offset + Recv_chunk_size, len(stream))]);
+			
+			for parse_message(&client, params) {};
+			
+			for queue.len(client.recv_commands) != 0 {
+				destroy_command(queue.pop_front(&client.recv_commands));
+				ring_parsed += 1;
+			}
+			free_all(context.temp_allocator);
+		}
+	}
+	time.stopwatch_stop(&ring_timer);
+
+	testing.expect_value(t, legacy_parsed, Message_count);
+	testing.expect_value(t, ring_parsed, Message_count);
+
+	mb := cast(f64)len(stream) / (1024 * 1024);
+	legacy_s := time.duration_seconds(time.stopwatch_duration(legacy_timer));
+	ring_s := time.duration_seconds(time.stopwatch_duration(ring_timer));
+	fmt.printf("recv parse, %i messages (%.2f MB) on one thread\n", Message_count, mb);
+	fmt.printf("\tper byte queue : %.2f MB/s\n", mb / legacy_s);
+	fmt.printf("\trecive ring    : %.2f MB/s (%.2fx)\n", mb / ring_s, legacy_s / ring_s);
+}
+
+when ODIN_OS == .Linux {
+	foreign import libc_rlimit "system:c"
+
+	@(private)
+	Rlimit :: struct {
+		cur, max : u64,
+	}
+
+	@(default_calling_convention="c", private)
+	foreign libc_rlimit {
+		getrlimit :: proc(resource : i32, rlim : ^Rlimit) -> i32 ---
+		setrlimit :: proc(resource : i32, rlim : ^Rlimit) -> i32 ---
+	}
+
+	//Every connection uses 2 file descriptors (client and server side), which goes above the default soft limit of 1024.
+	@(private)
+	raise_fd_limit :: proc (wanted : u64) {
+		RLIMIT_NOFILE :: 7;
+		lim : Rlimit;
+		if getrlimit(RLIMIT_NOFILE, &lim) == 0 && lim.cur < wanted {
+			lim.cur = min(wanted, lim.max);
+			setrlimit(RLIMIT_NOFILE, &lim);
+		}
+	}
+}
+else {
+	@(private)
+	raise_fd_limit :: proc (wanted : u64) {}
+}
+
+//Opens more then a 1000 clients over loopback against a reactor server, every client sends one message and we wait for all of them.
+@test
+test_reactor_many_clients :: proc (t : ^testing.T) {
+
+	Client_count :: 1024;
+	Reactor_game_port :: 26605;
+
+	Ping :: struct { client : u32, payload : [4]u64 };
+
+	commands_map : map[message_id_type]typeid = {
+		1 = Ping,
+	};
+	defer delete(commands_map);
+	allowed : typeid_set = { Ping = {} };
+	defer delete(allowed);
+	no_list : map[typeid][]typeid;
+
+	raise_fd_limit(2 * Client_count + 64);
+
+	params := make_params(proc(to_clean : any) {}, commands_map, allowed, no_list, no_list);
+	defer delete_params(&params);
+
+	endpoint := net.Endpoint{net.IP4_Loopback, Reactor_game_port};
+	server : Server;
+	make_server(&server, params, endpoint, .reactor, 4);
+
+	sockets := make([]net.TCP_Socket, Client_count);
+	defer delete(sockets);
+
+	connect_timer : time.Stopwatch;
+	time.stopwatch_start(&connect_timer);
+	for &s, i in sockets {
+		err : net.Network_Error;
+		s, err = net.dial_tcp(endpoint);
+		fmt.assertf(err == nil, "Failed to connect client %i, err : %v", i, err);
+	}
+	time.stopwatch_stop(&connect_timer);
+
+	for s, i in sockets {
+		send_message(s, params, Ping{client = u32(i)});
+	}
+
+	recived := 0;
+	recv_timer : time.Stopwatch;
+	time.stopwatch_start(&recv_timer);
+	for recived < Client_count && time.stopwatch_duration(recv_timer) < 10 * time.Second {
+		lock(&server.clients_mutex);
+		for _, client in server.clients {
+			lock(&client.commands_mutex);
+			for queue.len(client.recv_commands) != 0 {
+				destroy_command(queue.pop_front(&client.recv_commands));
+				recived += 1;
+			}
+			unlock(&client.commands_mutex);
+		}
+		unlock(&server.clients_mutex);
+		time.sleep(time.Millisecond);
+	}
+	time.stopwatch_stop(&recv_timer);
+
+	testing.expect_value(t, recived, Client_count);
+	fmt.printf("reactor : %i clients connected in %v, all messages recived in %v using %i event loops\n",
+		Client_count, time.stopwatch_duration(connect_timer), time.stopwatch_duration(recv_timer), len(server.reactor.loops));
+
+	for s in sockets {
+		net.close(s);
+	}
+
+	server.should_close = true;
+	close_server(&server);
+}
+
+//Parses a stream of 1M messages and counts the arenas created and the heap allocations done after warming up.
+@test
+bench_command_allocations :: proc (t : ^testing.T) {
+
+	Position :: struct { entity : u32, pos : [3]f32, vel : [3]f32 };
+	Chat_message :: struct { text : string };
+
+	Message_count :: 1_000_000;
+	Block_message_count :: 10_000;
+
+	commands_map : map[message_id_type]typeid = {
+		1 = Position,
+		2 = Chat_message,
+	};
+	defer delete(commands_map);
+	allowed : typeid_set = { Position = {}, Chat_message = {} };
+	defer delete(allowed);
+	no_list : map[typeid][]typeid;
+
+	params := make_params(proc(to_clean : any) {}, commands_map, allowed, no_list, no_list);
+	defer delete_params(&params);
+
+	block := make([dynamic]u8);
+	defer delete(block);
+	for i in 0..<Block_message_count {
+		if i % 8 == 0 {
+			append_test_message(&block, params, Chat_message{"A typical chat message of a typical length"});
+		}
+		else {
+			append_test_message(&block, params, Position{u32(i), {1, 2, 3}, {4, 5, 6}});
+		}
+	}
+
+	client : Client_base;
+	init_test_client_base(&client, params);
+	defer destroy_client_base(&client);
+
+	feed_block :: proc (client : ^Client_base, params : Network_params, block : []u8) -> (parsed : int) {
+		for offset := 0; offset < len(block); offset += Recv_chunk_size {
+			recv_buffer_append(&client.current_bytes_recv, block[offset:min(offset + Recv_chunk_size, len(block))]);
+			for parse_message(client, params) {};
+			for queue.len(client.recv_commands) != 0 {
+				destroy_command(queue.pop_front(&client.recv_commands));
+				parsed += 1;
+			}
+			free_all(context.temp_allocator);
+		}
+		return;
+	}
+
+	//Warm up, so the pool, the ring and the queue reaches their steady state size.
+	parsed := feed_block(&client, params, block[:]);
+	warm_arenas := client.arena_pool.arenas_created;
+
+	counter := utils.Counting_allocator{backing = context.allocator};
+	timer : time.Stopwatch;
+	time.stopwatch_start(&timer);
+	{
+		context.allocator = utils.counting_allocator(&counter);
+		for parsed < Message_count {
+			parsed += feed_block(&client, params, block[:]);
+		}
+	}
+	time.stopwatch_stop(&timer);
+
+	steady_arenas := client.arena_pool.arenas_created - warm_arenas;
+	testing.expect_value(t, steady_arenas, 0);
+
+	fmt.printf("command allocations, %i messages in %v\n", parsed, time.stopwatch_duration(timer));
+	fmt.printf("\tarenas created : %i during warm up, %i in steady state (before this was one per message)\n", warm_arenas, steady_arenas);
+	fmt.printf("\theap allocations in steady state : %i\n", counter.allocations);
+}
+
+//Meassures the cost of one broadcast against the amount of clients, sending per client (serializing every time) against send_broadcast.
+@test
+bench_broadcast :: proc (t : ^testing.T) {
+
+	Broadcast_port :: 26606;
+	Broadcast_count :: 50;
+
+	World_state :: struct {
+		tick : u64,
+		names : [dynamic]u8,
+		motd : string,
+	};
+
+	commands_map : map[message_id_type]typeid = {
+		1 = World_state,
+	};
+	defer delete(commands_map);
+	allowed : typeid_set = { World_state = {} };
+	defer delete(allowed);
+	no_list : map[typeid][]typeid;
+
+	params := make_params(proc(to_clean : any) {}, commands_map, allowed, no_list, no_list);
+	defer delete_params(&params);
+
+	state := World_state{tick = 1, names = make([dynamic]u8, 200), motd = "Welcome to the server, have fun and be nice"};
+	defer delete(state.names);
+
+	raise_fd_limit(2 * 500 + 64);
+
+	endpoint := net.Endpoint{net.IP4_Loopback, Broadcast_port};
+	acceptor, l_err := net.listen_tcp(endpoint);
+	fmt.assertf(l_err == nil, "Failed to listen, err : %v", l_err);
+	defer net.close(acceptor);
+
+	fmt.printf("broadcast of %i bytes\n", len(state.names) + len(state.motd));
+
+	for client_count in ([]int{10, 100, 500}) {
+		server : Server;
+		server.params = params;
+
+		remote_sockets := make([]net.TCP_Socket, client_count);
+		for &r, i in remote_sockets {
+			err : net.Network_Error;
+			r, err = net.dial_tcp(endpoint);
+			assert(err == nil);
+			c := new(Server_side_client);
+			c.client_id = i;
+			c.socket, c.endpoint, err = net.accept_tcp(acceptor);
+			assert(err == nil);
+			server.clients[i] = c;
+		}
+
+		per_client_timer : time.Stopwatch;
+		time.stopwatch_start(&per_client_timer);
+		for _ in 0..<Broadcast_count {
+			for _, client in server.clients {
+				send_message(client.socket, server.params, state);
+			}
+		}
+		time.stopwatch_stop(&per_client_timer);
+
+		shared_timer : time.Stopwatch;
+		time.stopwatch_start(&shared_timer);
+		for _ in 0..<Broadcast_count {
+			send_broadcast(&server, state);
+		}
+		time.stopwatch_stop(&shared_timer);
+
+		per_client := time.stopwatch_duration(per_client_timer) / Broadcast_count;
+		shared := time.stopwatch_duration(shared_timer) / Broadcast_count;
+		fmt.printf("\t%i clients : per client serialization %v, serialize once %v per broadcast\n", client_count, per_client, shared);
+
+		for _, c in server.clients {
+			net.close(c.socket);
+			free(c);
+		}
+		for r in remote_sockets {
+			net.close(r);
+		}
+		delete(remote_sockets);
+		delete(server.clients);
+	}
+}
+
+@(private)
+Drain_state :: struct {
+	server : ^Server,
+	recived : int,		//atomic
+	should_stop : bool,
+}
+
+//Destroys every command the server recives and counts them, runs until should_stop.
+@(private)
+drain_server_proc : thread.Thread_Proc : proc (t : ^thread.Thread) {
+	drain := cast(^Drain_state)t.data;
+
+	for !intrinsics.atomic_load(&drain.should_stop) {
+		lock(&drain.server.clients_mutex);
+		for _, client in drain.server.clients {
+			lock(&client.commands_mutex);
+			for queue.len(client.recv_commands) != 0 {
+				destroy_command(queue.pop_front(&client.recv_commands));
+				intrinsics.atomic_add(&drain.recived, 1);
+			}
+			unlock(&client.commands_mutex);
+		}
+		unlock(&drain.server.clients_mutex);
+		time.sleep(100 * time.Microsecond);
+	}
+}
+
+//Many tiny messages from a client, sending directly on the callers thread against the send queue (coalesced by the writer).
+@test
+bench_tiny_messages :: proc (t : ^testing.T) {
+
+	Tiny_port :: 26607;
+	Message_count :: 100_000;
+
+	Input :: struct { seq : u32, buttons : u16 };
+
+	commands_map : map[message_id_type]typeid = {
+		1 = Input,
+	};
+	defer delete(commands_map);
+	allowed : typeid_set = { Input = {} };
+	defer delete(allowed);
+	client_allowed : typeid_set;
+	no_list : map[typeid][]typeid;
+
+	endpoint := net.Endpoint{net.IP4_Loopback, Tiny_port};
+
+	for use_queues in ([]bool{false, true}) {
+		server_params := make_params(proc(to_clean : any) {}, commands_map, allowed, no_list, no_list);
+		client_params := make_params(proc(to_clean : any) {}, commands_map, client_allowed, no_list, no_list);
+		if use_queues {
+			enable_send_queues(&client_params);
+		}
+
+		server : Server;
+		make_server(&server, server_params, endpoint);
+
+		drain := Drain_state{server = &server};
+		drain_thread := thread.create(drain_server_proc, &drain);
+		thread.start(drain_thread);
+
+		client : Client;
+		make_client(&client, client_params);
+		Connect_client(&client, endpoint);
+
+		send_timer, total_timer : time.Stopwatch;
+		time.stopwatch_start(&total_timer);
+		time.stopwatch_start(&send_timer);
+		for i in 0..<Message_count {
+			send_message(&client, Input{u32(i), 0});
+		}
+		time.stopwatch_stop(&send_timer);
+
+		for intrinsics.atomic_load(&drain.recived) < Message_count && time.stopwatch_duration(total_timer) < 20 * time.Second {
+			time.sleep(time.Millisecond);
+		}
+		time.stopwatch_stop(&total_timer);
+
+		testing.expect_value(t, intrinsics.atomic_load(&drain.recived), Message_count);
+		fmt.printf("%i tiny messages, send queues %v : the sender spent %v, all recived after %v (%.0f messages/s)\n",
+			Message_count, use_queues, time.stopwatch_duration(send_timer), time.stopwatch_duration(total_timer),
+			cast(f64)Message_count / time.duration_seconds(time.stopwatch_duration(total_timer)));
+
+		close_client(&client);
+		intrinsics.atomic_store(&drain.should_stop, true);
+		thread.destroy(drain_thread);
+		free(drain_thread);
+
+		server.should_close = true;
+		close_server(&server);
+		delete_params(&server_params);
+		delete_params(&client_params);
+	}
+}
+
+//Round trip latency over loopback, the server thread and the client both block in wait_for_message.
+@test
+bench_round_trip_latency :: proc (t : ^testing.T) {
+
+	Latency_port :: 26608;
+	Round_trips :: 5_000;
+
+	Ping :: struct { seq : u32 };
+	Pong :: struct { seq : u32 };
+
+	commands_map : map[message_id_type]typeid = {
+		1 = Ping,
+		2 = Pong,
+	};
+	defer delete(commands_map);
+	server_allowed : typeid_set = { Ping = {} };
+	defer delete(server_allowed);
+	client_allowed : typeid_set = { Pong = {} };
+	defer delete(client_allowed);
+	no_list : map[typeid][]typeid;
+
+	server_params := make_params(proc(to_clean : any) {}, commands_map, server_allowed, no_list, no_list);
+	defer delete_params(&server_params);
+	client_params := make_params(proc(to_clean : any) {}, commands_map, client_allowed, no_list, no_list);
+	defer delete_params(&client_params);
+
+	endpoint := net.Endpoint{net.IP4_Loopback, Latency_port};
+	server : Server;
+	make_server(&server, server_params, endpoint);
+
+	Echo_state :: struct {
+		server : ^Server,
+		should_stop : bool,
+	};
+	echo := Echo_state{server = &server};
+
+	echo_proc : thread.Thread_Proc : proc (t : ^thread.Thread) {
+		echo := cast(^Echo_state)t.data;
+
+		client : ^Server_side_client;
+		for client == nil && !intrinsics.atomic_load(&echo.should_stop) {
+			lock(&echo.server.clients_mutex);
+			for _, c in echo.server.clients {
+				client = c;
+			}
+			unlock(&echo.server.clients_mutex);
+			time.sleep(time.Millisecond);
+		}
+
+		for !intrinsics.atomic_load(&echo.should_stop) {
+			ping, err := wait_for_message(client, Ping, 100 * time.Millisecond);
+			if !err {
+				send_message(client.socket, echo.server.params, Pong{ping.seq});
+			}
+		}
+	}
+
+	echo_thread := thread.create(echo_proc, &echo);
+	thread.start(echo_thread);
+
+	client : Client;
+	make_client(&client, client_params);
+	Connect_client(&client, endpoint);
+
+	durations := make([]time.Duration, Round_trips);
+	defer delete(durations);
+
+	for i in 0..<Round_trips {
+		timer : time.Stopwatch;
+		time.stopwatch_start(&timer);
+		send_message(&client, Ping{u32(i)});
+		pong, err := wait_for_message(&client, Pong);
+		time.stopwatch_stop(&timer);
+
+		testing.expect(t, !err && pong.seq == u32(i), "Did not get the matching pong");
+		durations[i] = time.stopwatch_duration(timer);
+	}
+
+	slice.sort(durations);
+	fmt.printf("round trip latency over %i pings : p50 %v, p99 %v, max %v\n", Round_trips,
+		durations[Round_trips / 2], durations[Round_trips * 99 / 100], durations[Round_trips - 1]);
+
+	intrinsics.atomic_store(&echo.should_stop, true);
+	thread.destroy(echo_thread);
+	free(echo_thread);
+
+	close_client(&client);
+	server.should_close = true;
+	close_server(&server);
+}
+
+//The per message dispatch decisions (type, allowed, allowing/disallowing, trivial) with the maps against the compiled table.
+@test
+bench_dispatch_table :: proc (t : ^testing.T) {
+
+	Dispatch_count :: 10_000_000;
+
+	A :: struct { v : u32 };
+	B :: struct { v : [4]f32 };
+	C :: struct { v : string };
+	D :: struct { v : [dynamic]u8 };
+	E :: struct { v : u64, w : u8 };
+	F :: struct { v : [16]u8 };
+	G :: struct {};
+	H :: struct { v : string, w : u32 };
+
+	commands_map : map[message_id_type]typeid = {
+		10 = A, 200 = B, 3000 = C, 4 = D, 50 = E, 600 = F, 7000 = G, 8 = H,
+	};
+	defer delete(commands_map);
+	allowed : typeid_set = { A = {}, B = {}, C = {}, D = {}, E = {}, F = {}, G = {}, H = {} };
+	defer delete(allowed);
+	allowing : map[typeid][]typeid = { A = {B}, G = {H, C} };
+	defer delete(allowing);
+	disallowing : map[typeid][]typeid = { C = {C} };
+	defer delete(disallowing);
+
+	params := make_params(proc(to_clean : any) {}, commands_map, allowed, allowing, disallowing);
+	defer delete_params(&params);
+
+	ids := [?]message_id_type{10, 200, 3000, 4, 50, 600, 7000, 8, 10, 10, 200, 50};
+
+	/////////// Maps ///////////
+	client_set := make(typeid_set);
+	defer delete(client_set);
+	for k, v in allowed {
+		client_set[k] = v;
+	}
+
+	map_checksum := 0;
+	map_timer : time.Stopwatch;
+	time.stopwatch_start(&map_timer);
+	for i in 0..<Dispatch_count {
+		id := ids[i % len(ids)];
+		if !(id in params.commands) {
+			continue;
+		}
+		cmd_type := params.commands[id];
+		if utils.is_trivial_copied(cmd_type) {
+			map_checksum += 1;
+		}
+		if cmd_type in client_set {
+			map_checksum += 2;
+		}
+		if cmd_type in params.command_allowing {
+			for new_command in params.command_allowing[cmd_type] {
+				client_set[new_command] = {};
+			}
+		}
+		if cmd_type in params.command_disallowing {
+			for to_remove in params.command_disallowing[cmd_type] {
+				delete_key(&client_set, to_remove);
+			}
+		}
+	}
+	time.stopwatch_stop(&map_timer);
+
+	/////////// Table ///////////
+	client_bits := make_allowed_commands(params);
+	defer delete(client_bits);
+
+	table_checksum := 0;
+	table_timer : time.Stopwatch;
+	time.stopwatch_start(&table_timer);
+	for i in 0..<Dispatch_count {
+		id := ids[i % len(ids)];
+		index := params.command_index[id];
+		if index == 0 {
+			continue;
+		}
+		info := &params.command_infos[index - 1];
+		if info.is_trivial {
+			table_checksum += 1;
+		}
+		if command_bitset_get(client_bits, info.index) {
+			table_checksum += 2;
+		}
+		for new_command in info.allowing {
+			command_bitset_set(client_bits, new_command, true);
+		}
+		for to_remove in info.disallowing {
+			command_bitset_set(client_bits, to_remove, false);
+		}
+	}
+	time.stopwatch_stop(&table_timer);
+
+	testing.expect_value(t, table_checksum, map_checksum);
+
+	map_ns := cast(f64)time.stopwatch_duration(map_timer) / Dispatch_count;
+	table_ns := cast(f64)time.stopwatch_duration(table_timer) / Dispatch_count;
+	fmt.printf("dispatch, %i messages : maps %.1f ns/message, table %.1f ns/message (%.1fx)\n", Dispatch_count, map_ns, table_ns, map_ns / table_ns);
+}
+
+@test
+test_zero_copy_commands :: proc (t : ^testing.T) {
+
+	Position :: struct { entity : u32, pos : [3]f32, vel : [3]f32 };
+	Chat_message :: struct { text : string };
+
+	Message_count :: 5_000;
+
+	commands_map : map[message_id_type]typeid = {
+		1 = Position,
+		2 = Chat_message,
+	};
+	defer delete(commands_map);
+	allowed : typeid_set = { Position = {}, Chat_message = {} };
+	defer delete(allowed);
+	no_list : map[typeid][]typeid;
+
+	params := make_params(proc(to_clean : any) {}, commands_map, allowed, no_list, no_list);
+	defer delete_params(&params);
+	enable_zero_copy(&params, Position);
+
+	stream := make([dynamic]u8);
+	defer delete(stream);
+	for i in 0..<Message_count {
+		append_test_message(&stream, params, Position{u32(i), {1, 2, 3}, {4, 5, 6}});
+	}
+
+	client : Client_base;
+	init_test_client_base(&client, params);
+	defer destroy_client_base(&client);
+
+	//The commands are held while more bytes arrives, so the recive buffer must move to new blocks instead of moving the bytes.
+	first_block := client.current_bytes_recv.block;
+	held := make([dynamic]Command);
+	defer delete(held);
+	for offset := 0; offset < len(stream); offset += Recv_chunk_size {
+		recv_buffer_append(&client.current_bytes_recv, stream[offset:min(offset + Recv_chunk_size, len(stream))]);
+		for parse_message(&client, params) {};
+		for queue.len(client.recv_commands) != 0 {
+			append(&held, queue.pop_front(&client.recv_commands));
+		}
+	}
+
+	testing.expect_value(t, len(held), Message_count);
+	testing.expect_value(t, client.arena_pool.arenas_created, 0);
+	testing.expect(t, client.current_bytes_recv.block != first_block, "expected the recive buffer to leave the pinned block");
+
+	for com, i in held {
+		testing.expect(t, !com.owns_memory);
+		pos := command_view(com, Position);
+		testing.expect_value(t, pos.entity, u32(i));
+		testing.expect_value(t, pos.vel, [3]f32{4, 5, 6});
+	}
+
+	//The buffer moved on, so the first block is only kept by the commands pointing into it.
+	in_first := 0;
+	for com in held {
+		if com.view_of == first_block {
+			in_first += 1;
+		}
+	}
+	testing.expect(t, in_first != 0);
+	testing.expect_value(t, first_block.refs, in_first);
+
+	destroy_commands(held[:]);
+	testing.expect_value(t, client.current_bytes_recv.block.refs, 1);
+
+	//Without views the bytes are reused in place.
+	current := client.current_bytes_recv.block;
+	recv_buffer_append(&client.current_bytes_recv, stream[:size_of(message_id_type) + size_of(Position)]);
+	testing.expect_value(t, client.current_bytes_recv.block, current);
+	for parse_message(&client, params) {};
+	testing.expect_value(t, queue.len(client.recv_commands), 1);
+	destroy_command(queue.pop_front(&client.recv_commands));
+}
+
+//A zero copy command must stay valid when its client is destroyed before the command is.
+@test
+test_zero_copy_outlives_client :: proc (t : ^testing.T) {
+
+	Position :: struct { entity : u32, pos : [3]f32, vel : [3]f32 };
+
+	commands_map : map[message_id_type]typeid = {
+		1 = Position,
+	};
+	defer delete(commands_map);
+	allowed : typeid_set = { Position = {} };
+	defer delete(allowed);
+	no_list : map[typeid][]typeid;
+
+	params := make_params(proc(to_clean : any) {}, commands_map, allowed, no_list, no_list);
+	defer delete_params(&params);
+	enable_zero_copy(&params, Position);
+
+	stream := make([dynamic]u8);
+	defer delete(stream);
+	append_test_message(&stream, params, Position{7, {1, 2, 3}, {4, 5, 6}});
+
+	client : Client_base;
+	init_test_client_base(&client, params);
+	recv_buffer_append(&client.current_bytes_recv, stream[:]);
+	for parse_message(&client, params) {};
+	testing.expect_value(t, queue.len(client.recv_commands), 1);
+	com := queue.pop_front(&client.recv_commands);
+
+	destroy_client_base(&client);
+
+	testing.expect_value(t, com.view_of.refs, 1);
+	pos := command_view(com, Position);
+	testing.expect_value(t, pos.entity, u32(7));
+	testing.expect_value(t, pos.vel, [3]f32{4, 5, 6});
+	destroy_command(com);
+}
+
+//A message that can not be deserialized disconnects the client instead of crashing the server.
+@test
+test_invalid_message_disconnects :: proc (t : ^testing.T) {
+
+	Chat_message :: struct { text : string };
+
+	commands_map : map[message_id_type]typeid = {
+		1 = Chat_message,
+	};
+	defer delete(commands_map);
+	allowed : typeid_set = { Chat_message = {} };
+	defer delete(allowed);
+	no_list : map[typeid][]typeid;
+
+	params := make_params(proc(to_clean : any) {}, commands_map, allowed, no_list, no_list);
+	defer delete_params(&params);
+
+	stream := make([dynamic]u8);
+	defer delete(stream);
+	append_test_message(&stream, params, Chat_message{"A typical chat message"});
+
+	//Cut the end of the text off and make the size header agree, so the length of the text is what is wrong.
+	resize(&stream, len(stream) - 3);
+	(cast(^utils.Header_size_type)&stream[size_of(message_id_type)])^ -= 3;
+	append_test_message(&stream, params, Chat_message{"Not parsed"});
+
+	client : Client_base;
+	init_test_client_base(&client, params);
+	defer destroy_client_base(&client);
+
+	recv_buffer_append(&client.current_bytes_recv, stream[:]);
+	testing.expect(t, !parse_message(&client, params));
+	testing.expect(t, client.should_close, "expected the client to be disconnected");
+	testing.expect_value(t, queue.len(client.recv_commands), 0);
+}
+
+@test
+test_udp_channel_loopback :: proc (t : ^testing.T) {
+
+	Snapshot :: struct { tick : u32, pos : [3]f32 };
+	Event :: struct { index : u32, text : string };
+
+	Snapshot_count :: 300;
+	Event_count :: 200;
+
+	commands_map : map[message_id_type]typeid = {
+		1 = Snapshot,
+		2 = Event,
+	};
+	defer delete(commands_map);
+	allowed : typeid_set = { Snapshot = {}, Event = {} };
+	defer delete(allowed);
+	no_list : map[typeid][]typeid;
+
+	params := make_params(proc(to_clean : any) {}, commands_map, allowed, no_list, no_list);
+	defer delete_params(&params);
+
+	//30% loss and jitter above the send interval, so the snapshots are reordered.
+	config := Default_udp_config;
+	config.resend_interval = 20 * time.Millisecond;
+	config.shim = {loss = 0.3, latency = 2 * time.Millisecond, jitter = 5 * time.Millisecond, seed = 1234};
+
+	a_endpoint := net.Endpoint{net.IP4_Loopback, 26609};
+	b_endpoint := net.Endpoint{net.IP4_Loopback, 26610};
+
+	a, b : Udp_channel;
+	testing.expect_value(t, udp_channel_init(&a, params, a_endpoint, b_endpoint, config), nil);
+	defer udp_channel_destroy(&a);
+	testing.expect_value(t, udp_channel_init(&b, params, b_endpoint, {}, config), nil); //b adopts a as its peer.
+	defer udp_channel_destroy(&b);
+
+	for i in 0..<Event_count {
+		udp_send_reliable(&a, Event{u32(i), "An event which must arrive"});
+	}
+
+	snapshots_recived := 0;
+	last_tick : Maybe(u32);
+	events_recived := 0;
+	sent_snapshots := 0;
+
+	deadline := time.tick_add(time.tick_now(), 10 * time.Second);
+	for events_recived < Event_count && time.tick_diff(time.tick_now(), deadline) > 0 {
+		if sent_snapshots < Snapshot_count {
+			udp_send_unreliable(&a, Snapshot{u32(sent_snapshots), {1, 2, 3}});
+			sent_snapshots += 1;
+		}
+
+		udp_channel_poll(&a);
+		udp_channel_poll(&b);
+
+		for com in udp_pop_command(&b) {
+			switch v in com.value {
+				case Snapshot:
+					if last, ok := last_tick.?; ok {
+						testing.expect(t, v.tick > last, "a stale snapshot was delivered");
+					}
+					last_tick = v.tick;
+					snapshots_recived += 1;
+				case Event:
+					testing.expect_value(t, v.index, u32(events_recived)); //In order and exactly once.
+					testing.expect_value(t, v.text, "An event which must arrive");
+					events_recived += 1;
+				case:
+					testing.fail(t);
+			}
+			destroy_command(com);
+		}
+
+		time.sleep(time.Millisecond);
+	}
+
+	testing.expect_value(t, events_recived, Event_count);
+	testing.expect(t, snapshots_recived > 0 && snapshots_recived < Snapshot_count, "expected some, but not all, snapshots to arrive");
+
+	fmt.printf("udp channel : %i/%i snapshots recived, %i stale dropped, %i reliable resends, %i datagrams dropped by the shim\n",
+		snapshots_recived, sent_snapshots, b.stale_dropped, a.resent, a.shim_dropped + b.shim_dropped);
+}
+
+@test
+bench_delta_snapshots :: proc (t : ^testing.T) {
+
+	Entity :: struct { pos : [3]f32, vel : [3]f32, health : u32, flags : u32 };
+	World_state :: struct { tick : u64, entities : [256]Entity };
+
+	Tick_count :: 1_000;
+	Changed_per_tick :: 8;
+	Ack_delay :: 3; //The acks arrives this many ticks late.
+
+	commands_map : map[message_id_type]typeid = {
+		1 = World_state,
+		2 = Delta_message,
+		3 = Snapshot_ack,
+	};
+	defer delete(commands_map);
+	allowed : typeid_set = { World_state = {}, Delta_message = {}, Snapshot_ack = {} };
+	defer delete(allowed);
+	no_list : map[typeid][]typeid;
+
+	params := make_params(proc(to_clean : any) {}, commands_map, allowed, no_list, no_list);
+	defer delete_params(&params);
+
+	enc : Delta_encoder;
+	delta_encoder_init(&enc, params, World_state);
+	defer delta_encoder_destroy(&enc);
+
+	dec : Delta_decoder;
+	delta_decoder_init(&dec, params, World_state);
+	defer delta_decoder_destroy(&dec);
+
+	state := new(World_state);
+	defer free(state);
+	recived := new(World_state);
+	defer free(recived);
+
+	pending_acks := make([dynamic]Snapshot_ack);
+	defer delete(pending_acks);
+
+	wire := make([dynamic]u8);
+	defer delete(wire);
+
+	for tick in 0..<Tick_count {
+		state.tick = cast(u64)tick;
+		for c in 0..<Changed_per_tick {
+			e := &state.entities[(tick * 31 + c * 7) % len(state.entities)];
+			e.pos += e.vel + {1, 0, 0};
+			e.health = cast(u32)tick;
+		}
+
+		msg := delta_encode(&enc, state^);
+
+		//Through the real encoding, as it would go over the wire.
+		clear(&wire);
+		testing.expect_value(t, encode_message(params, msg^, &wire), utils.Serialization_error.ok);
+
+		ack, ok := delta_decode(&dec, msg^, recived^);
+		testing.expect(t, ok, "failed to decode snapshot");
+		testing.expect(t, mem.compare_ptrs(state, recived, size_of(World_state)) == 0, "the decoded state differs");
+
+		append(&pending_acks, ack);
+		if len(pending_acks) > Ack_delay {
+			delta_encoder_ack(&enc, pending_acks[0]);
+			ordered_remove(&pending_acks, 0);
+		}
+	}
+
+	testing.expect(t, delta_compression_ratio(enc) < 0.2, "expected the deltas to be much smaller then the state");
+
+	fmt.printf("delta snapshots, %i bytes state, %i changed entities per tick : compression ratio %.3f (%.0f bytes per snapshot), encode %.2f us per snapshot\n",
+		size_of(World_state), Changed_per_tick, delta_compression_ratio(enc), cast(f64)enc.encoded_bytes / cast(f64)enc.snapshots,
+		time.duration_microseconds(enc.encode_time) / cast(f64)enc.snapshots);
+}
+
+@test
+test_metrics_counters :: proc (t : ^testing.T) {
+
+	Position :: struct { entity : u32, pos : [3]f32, vel : [3]f32 };
+	Chat_message :: struct { text : string };
+	Unused :: struct { v : u8 };
+
+	commands_map : map[message_id_type]typeid = {
+		1 = Position,
+		2 = Chat_message,
+		3 = Unused,
+	};
+	defer delete(commands_map);
+	allowed : typeid_set = { Position = {}, Chat_message = {}, Unused = {} };
+	defer delete(allowed);
+	no_list : map[typeid][]typeid;
+
+	params := make_params(proc(to_clean : any) {}, commands_map, allowed, no_list, no_list);
+	defer delete_params(&params);
+	enable_metrics(&params);
+
+	stream := make([dynamic]u8);
+	defer delete(stream);
+	chat_bytes := 0;
+	for i in 0..<30 {
+		if i % 3 == 0 {
+			before := len(stream);
+			append_test_message(&stream, params, Chat_message{"A typical chat message of a typical length"});
+			chat_bytes += len(stream) - before;
+		}
+		else {
+			append_test_message(&stream, params, Position{u32(i), {1, 2, 3}, {4, 5, 6}});
+		}
+	}
+
+	client : Client_base;
+	init_test_client_base(&client, params);
+	defer destroy_client_base(&client);
+
+	recv_buffer_append(&client.current_bytes_recv, stream[:]);
+	//Half a message is left unparsed, so it shows up as recive buffer depth.
+	recv_buffer_append(&client.current_bytes_recv, stream[:5]);
+	for parse_message(&client, params) {};
+
+	snapshot := client_metrics_snapshot(&client, params);
+	defer delete_metrics_snapshot(snapshot);
+
+	testing.expect_value(t, len(snapshot.commands), 2); //Unused had no traffic.
+	for c in snapshot.commands {
+		switch c.type {
+			case Position:
+				testing.expect_value(t, c.messages_in, 20);
+				testing.expect_value(t, c.bytes_in, u64(20 * (size_of(message_id_type) + size_of(Position))));
+			case Chat_message:
+				testing.expect_value(t, c.messages_in, 10);
+				testing.expect_value(t, c.bytes_in, u64(chat_bytes));
+			case:
+				testing.fail(t);
+		}
+	}
+	testing.expect_value(t, snapshot.total.messages_in, 30);
+	testing.expect_value(t, snapshot.total.bytes_in, u64(len(stream)));
+	testing.expect_value(t, snapshot.recv_buffer_bytes, 5);
+	testing.expect_value(t, snapshot.recv_commands, 30);
+}
+
+@test
+test_record_and_replay :: proc (t : ^testing.T) {
+
+	Record_port :: 26611;
+	Replay_port :: 26612;
+	Message_count :: 500;
+	Session_path :: "network_test_session.bin";
+
+	Input :: struct { seq : u32, buttons : u16 };
+	Chat_message :: struct { text : string };
+
+	commands_map : map[message_id_type]typeid = {
+		1 = Input,
+		2 = Chat_message,
+	};
+	defer delete(commands_map);
+	allowed : typeid_set = { Input = {}, Chat_message = {} };
+	defer delete(allowed);
+	client_allowed : typeid_set;
+	no_list : map[typeid][]typeid;
+
+	server_params := make_params(proc(to_clean : any) {}, commands_map, allowed, no_list, no_list);
+	defer delete_params(&server_params);
+	client_params := make_params(proc(to_clean : any) {}, commands_map, client_allowed, no_list, no_list);
+	defer delete_params(&client_params);
+
+	/////////// Record ///////////
+	{
+		endpoint := net.Endpoint{net.IP4_Loopback, Record_port};
+		server : Server;
+		make_server(&server, server_params, endpoint);
+		testing.expect(t, start_recording(&server, Session_path));
+
+		drain := Drain_state{server = &server};
+		drain_thread := thread.create(drain_server_proc, &drain);
+		thread.start(drain_thread);
+
+		clients : [2]Client;
+		for &c in clients {
+			make_client(&c, client_params);
+			Connect_client(&c, endpoint);
+		}
+		for i in 0..<Message_count {
+			c := &clients[i % len(clients)];
+			if i % 5 == 0 {
+				send_message(c, Chat_message{"recorded"});
+			}
+			else {
+				send_message(c, Input{u32(i), 3});
+			}
+		}
+
+		for intrinsics.atomic_load(&drain.recived) < Message_count {
+			time.sleep(time.Millisecond);
+		}
+		stop_recording(&server);
+
+		intrinsics.atomic_store(&drain.should_stop, true);
+		thread.destroy(drain_thread);
+		free(drain_thread);
+		for &c in clients {
+			close_client(&c);
+		}
+		server.should_close = true;
+		close_server(&server);
+	}
+	defer os.remove(Session_path);
+
+	session, ok := load_session(Session_path);
+	testing.expect(t, ok, "failed to load the session");
+	defer delete_session(session);
+
+	testing.expect_value(t, len(session.records), Message_count);
+	clients_seen := make(map[u32]int);
+	defer delete(clients_seen);
+	for r, i in session.records {
+		clients_seen[r.client] += 1;
+		id := utils.to_type(r.message, message_id_type);
+		testing.expect(t, id == 1 || id == 2, "unexpected message id in the recording");
+		if i != 0 {
+			testing.expect(t, r.time >= session.records[i - 1].time, "the records are not in time order");
+		}
+	}
+	testing.expect_value(t, len(clients_seen), 2);
+
+	/////////// Replay as fast as possible ///////////
+	{
+		endpoint := net.Endpoint{net.IP4_Loopback, Replay_port};
+		server : Server;
+		make_server(&server, server_params, endpoint);
+
+		drain := Drain_state{server = &server};
+		drain_thread := thread.create(drain_server_proc, &drain);
+		thread.start(drain_thread);
+
+		replay : Replay;
+		testing.expect(t, replay_session(&replay, session, endpoint, 0), "the replay failed");
+		stats := replay.stats;
+		testing.expect_value(t, stats.messages, Message_count);
+		testing.expect_value(t, stats.clients, 2);
+
+		timer : time.Stopwatch;
+		time.stopwatch_start(&timer);
+		for intrinsics.atomic_load(&drain.recived) < Message_count && time.stopwatch_duration(timer) < 10 * time.Second {
+			time.sleep(time.Millisecond);
+		}
+		testing.expect_value(t, intrinsics.atomic_load(&drain.recived), Message_count);
+
+		fmt.printf("replayed %i messages (%i bytes) from %i clients in %v\n", stats.messages, stats.bytes, stats.clients, stats.duration);
+
+		intrinsics.atomic_store(&drain.should_stop, true);
+		thread.destroy(drain_thread);
+		free(drain_thread);
+		close_replay(&replay);
+		server.should_close = true;
+		close_server(&server);
+	}
+}
+
+@test
+test_dispatch_worker_pool :: proc (t : ^testing.T) {
+
+	Dispatch_port :: 26613;
+	Client_count :: 8;
+	Message_count :: 2_000;	//Per client
+
+	Work :: struct { client : u32, seq : u32, iterations : u32 };
+
+	commands_map : map[message_id_type]typeid = {
+		1 = Work,
+	};
+	defer delete(commands_map);
+	allowed : typeid_set = { Work = {} };
+	defer delete(allowed);
+	client_allowed : typeid_set;
+	no_list : map[typeid][]typeid;
+
+	server_params := make_params(proc(to_clean : any) {}, commands_map, allowed, no_list, no_list);
+	defer delete_params(&server_params);
+	client_params := make_params(proc(to_clean : any) {}, commands_map, client_allowed, no_list, no_list);
+	defer delete_params(&client_params);
+
+	Dispatch_test_state :: struct {
+		next_seq : [Client_count]u32,	//Only touched by the shard of the client, so no atomics needed.
+		out_of_order : int,				//atomic
+	};
+	state : Dispatch_test_state;
+
+	handler : Dispatch_handler : proc (server : ^Server, client_id : client_id_type, command : Command, user_data : rawptr) -> rawptr {
+		state := cast(^Dispatch_test_state)user_data;
+		work := command_view(command, Work);
+
+		if work.seq != state.next_seq[work.client] {
+			intrinsics.atomic_add(&state.out_of_order, 1);
+		}
+		state.next_seq[work.client] = work.seq + 1;
+
+		//Something CPU heavy.
+		acc : f64 = 1;
+		for i in 0..<work.iterations {
+			acc = acc * 1.0000001 + cast(f64)i;
+		}
+
+		return cast(rawptr)uintptr(acc != 0);
+	};
+
+	endpoint := net.Endpoint{net.IP4_Loopback, Dispatch_port};
+	server : Server;
+	make_server(&server, server_params, endpoint);
+	start_dispatch(&server, handler, &state);
+
+	clients : [Client_count]Client;
+	for &c in clients {
+		make_client(&c, client_params);
+		Connect_client(&c, endpoint);
+	}
+
+	timer : time.Stopwatch;
+	time.stopwatch_start(&timer);
+
+	//Each client sends from its own thread, the client id is the index (they connect in order).
+	Sender_data :: struct { client : ^Client, index : u32 };
+	sender_data : [Client_count]Sender_data;
+	senders : [Client_count]^thread.Thread;
+	for &c, i in clients {
+		sender_data[i] = {&c, u32(i)};
+		senders[i] = thread.create(proc (t : ^thread.Thread) {
+			data := cast(^Sender_data)t.data;
+			for seq in 0..<Message_count {
+				send_message(data.client, Work{data.index, u32(seq), 10_000});
+			}
+		}, &sender_data[i]);
+		thread.start(senders[i]);
+	}
+
+	completions := 0;
+	for completions < Client_count * Message_count && time.stopwatch_duration(timer) < 30 * time.Second {
+		for c in pop_completion(&server) {
+			testing.expect(t, c.type == Work);
+			completions += 1;
+		}
+		time.sleep(100 * time.Microsecond);
+	}
+	time.stopwatch_stop(&timer);
+
+	testing.expect_value(t, completions, Client_count * Message_count);
+	testing.expect_value(t, intrinsics.atomic_load(&state.out_of_order), 0);
+
+	fmt.printf("dispatch, %i clients x %i commands handled on %i job workers in %v\n", Client_count, Message_count, utils.jobs_worker_count(), time.stopwatch_duration(timer));
+
+	for s in senders {
+		thread.destroy(s);
+		free(s);
+	}
+	for &c in clients {
+		close_client(&c);
+	}
+	server.should_close = true;
+	close_server(&server);
+}
+
+@test
+test_interest_grid :: proc (t : ^testing.T) {
+
+	grid : Interest_grid;
+	interest_grid_init(&grid, 10);
+	defer interest_grid_destroy(&grid);
+
+	interest_subscribe(&grid, 1, {0, 0}, 15);
+	interest_subscribe(&grid, 2, {100, 100}, 15);
+
+	near_one := interest_clients_at(&grid, {5, 5});
+	testing.expect(t, len(near_one) == 1 && near_one[0] == 1, "expected only client 1 near the origin");
+	testing.expect_value(t, len(interest_clients_at(&grid, {-500, 300})), 0);
+
+	//Moving inside the same cells touches nothing.
+	changed := grid.cells_changed;
+	interest_subscribe(&grid, 1, {1, 1}, 15);
+	testing.expect_value(t, grid.cells_changed, changed);
+
+	//Moving one cell over only touches the column that was left and the one that was entered.
+	changed = grid.cells_changed;
+	interest_subscribe(&grid, 1, {11, 1}, 15);
+	testing.expect_value(t, grid.cells_changed - changed, 2 * 4);
+
+	interest_subscribe(&grid, 1, {100, 90}, 15);
+	testing.expect_value(t, len(interest_clients_at(&grid, {100, 100})), 2);
+	testing.expect_value(t, len(interest_clients_at(&grid, {5, 5})), 0);
+
+	interest_set_entity(&grid, 77, {-100, -100});
+	testing.expect_value(t, grid.entities[77], interest_cell_of(&grid, {-100, -100}));
+
+	interest_unsubscribe(&grid, 1);
+	interest_unsubscribe(&grid, 2);
+	testing.expect_value(t, len(grid.cells), 0);
+
+	/////////// Many clients walking around a big world ///////////
+	Client_count :: 10_000;
+	World_size :: 100_000;
+	Tick_count :: 100;
+
+	positions := make([][2]f32, Client_count);
+	defer delete(positions);
+	for &p, i in positions {
+		p = {cast(f32)((i * 7919) % World_size), cast(f32)((i * 104729) % World_size)};
+		interest_subscribe(&grid, i, p, 50);
+	}
+
+	changed = grid.cells_changed;
+	timer : time.Stopwatch;
+	time.stopwatch_start(&timer);
+	for tick in 0..<Tick_count {
+		for &p, i in positions {
+			p += {cast(f32)((i + tick) % 3) - 1, 1}; //About walking speed
+			interest_subscribe(&grid, i, p, 50);
+		}
+	}
+	time.stopwatch_stop(&timer);
+
+	fmt.printf("interest grid, %i clients moving for %i ticks : %.1f us per tick, %.2f cell changes per client per tick\n", Client_count, Tick_count,
+		time.duration_microseconds(time.stopwatch_duration(timer)) / Tick_count, cast(f64)(grid.cells_changed - changed) / (Client_count * Tick_count));
+}
+
 /* 
 //Very simple setup, minimal code example
 //This might failed as we try to conenct to the server before it is garentied to be created...
@@ -0,0 +1,454 @@
+package network
+
+import "core:fmt"
+import "core:mem"
+import "core:net"
+import "core:slice"
+import "core:time"
+
+import mem_virtual "core:mem/virtual"
+
+import "core:container/queue"
+
+import "../utils"
+
+import "../tracy"
+
+//A UDP channel next to the TCP connection, it uses the same Network_params command map.
+//It is for high frequency state (snapshots), where a lost packet must not hold back the newer ones like it does on TCP.
+//Unreliable messages are latest wins, a message older then the newest recived of the same command is dropped.
+//Reliable messages are resend until acked and are delivered in order, use them for (rare) events.
+//The channel is point to point and polled, call udp_channel_poll regularly (it also does the resending).
+
+Udp_protocol_id		:: 0x4E55;	//The first bytes of every datagram, others are ignored.
+Udp_max_datagram	:: 1200;	//Stay below the common MTU, so we are never fragmented.
+Udp_reliable_window	:: 1024;	//Reliable messages further ahead then this are dropped (and resend later).
+
+Udp_packet_kind :: enum u8 {
+	unreliable,
+	reliable,
+	ack,
+}
+
+Udp_header :: struct #packed {
+	protocol : u16,
+	kind : Udp_packet_kind,
+	sequence : u32,		//unreliable : the send sequence, reliable : the reliable sequence, ack : the last reliable sequence recived in order.
+}
+
+//Fakes a bad network on the sending side, so the channel can be tested over loopback.
+Udp_shim :: struct {
+	loss : f32,					//0 to 1, the chance a datagram is dropped.
+	latency : time.Duration,
+	jitter : time.Duration,		//A random extra latency between 0 and jitter, this reorders datagrams.
+	seed : u64,
+}
+
+Udp_config :: struct {
+	resend_interval : time.Duration,
+	shim : Udp_shim,
+}
+
+Default_udp_config :: Udp_config{
+	resend_interval = 100 * time.Millisecond,
+}
+
+@(private)
+Udp_unacked :: struct {
+	sequence : u32,
+	data : []u8,			//The full datagram.
+	last_sent : time.Tick,
+}
+
+@(private)
+Udp_delayed :: struct {
+	send_at : time.Tick,
+	data : []u8,
+}
+
+Udp_channel :: struct {
+	socket : net.UDP_Socket,
+	remote : net.Endpoint,			//If the port is 0 the first peer to send to us is adopted.
+	params : Network_params,
+	config : Udp_config,
+
+	//Unreliable
+	send_sequence : u32,
+	latest_recived : []u32,			//Per command index, the newest unreliable sequence recived.
+	has_recived : Command_bitset,
+
+	//Reliable
+	reliable_sequence : u32,		//The next reliable sequence to send.
+	unacked : [dynamic]Udp_unacked,
+	reliable_next : u32,			//The next reliable sequence we expect.
+	out_of_order : map[u32][]u8,	//Reliable messages recived ahead of reliable_next.
+	should_ack : bool,
+
+	delayed : [dynamic]Udp_delayed,	//Datagrams held back by the shim.
+	rng_state : u64,
+
+	recv_commands : queue.Queue(Command),
+	allowed_commands : Command_bitset,
+	arena_pool : Arena_pool,
+	scratch : [dynamic]u8,
+
+	mutex : utils.Mutex,
+
+	//Stats
+	stale_dropped : int,
+	invalid_dropped : int,		//Datagrams with a message we could not decode.
+	resent : int,
+	shim_dropped : int,
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+//Binds a UDP socket to local, remote can have port 0 if it is not known yet (the server side), then the first peer to send is adopted.
+udp_channel_init :: proc (channel : ^Udp_channel, params : Network_params, local : net.Endpoint, remote : net.Endpoint = {}, config := Default_udp_config, loc := #caller_location) -> (err : net.Network_Error) {
+	tracy.Zone();
+
+	channel^ = {};
+
+	channel.socket = net.make_bound_udp_socket(local.address, local.port) or_return;
+	net.set_blocking(channel.socket, false) or_return;
+
+	channel.remote = remote;
+	channel.params = params;
+	channel.config = config;
+
+	channel.latest_recived = make([]u32, len(params.command_infos));
+	channel.has_recived = make(Command_bitset, len(params.initial_allowed_bits));
+	channel.unacked = make([dynamic]Udp_unacked);
+	channel.out_of_order = make(map[u32][]u8);
+	channel.delayed = make([dynamic]Udp_delayed);
+	channel.rng_state = config.shim.seed | 1;
+
+	queue.init(&channel.recv_commands);
+	channel.allowed_commands = make_allowed_commands(params);
+	arena_pool_init(&channel.arena_pool);
+	channel.scratch = make([dynamic]u8, 0, Udp_max_datagram);
+
+	return nil;
+}
+
+//Closes the socket, unsent and unacked messages are lost.
+udp_channel_destroy :: proc (using channel : ^Udp_channel) {
+	tracy.Zone();
+
+	net.close(socket);
+
+	for queue.len(recv_commands) != 0 {
+		destroy_command(queue.pop_front(&recv_commands));
+	}
+	queue.destroy(&recv_commands);
+
+	for u in unacked {
+		delete(u.data);
+	}
+	for _, data in out_of_order {
+		delete(data);
+	}
+	for d in delayed {
+		delete(d.data);
+	}
+
+	delete(latest_recived);
+	delete(has_recived);
+	delete(unacked);
+	delete(out_of_order);
+	delete(delayed);
+	delete(allowed_commands);
+	delete(scratch);
+	arena_pool_destroy(&arena_pool);
+
+	channel^ = {};
+}
+
+//Sends a latest wins message, it might be lost, duplicated or arrive out of order (then it is dropped).
+udp_send_unreliable :: proc (using channel : ^Udp_channel, data : any, loc := #caller_location) {
+	tracy.Zone();
+
+	lock(&mutex);
+	defer unlock(&mutex);
+
+	_udp_encode(channel, .unreliable, send_sequence, data, loc);
+	send_sequence += 1;
+
+	_udp_send_datagram(channel, scratch[:]);
+}
+
+//Sends a message which is resend until acked, they are delivered in the order they are send.
+udp_send_reliable :: proc (using channel : ^Udp_channel, data : any, loc := #caller_location) {
+	tracy.Zone();
+
+	lock(&mutex);
+	defer unlock(&mutex);
+
+	_udp_encode(channel, .reliable, reliable_sequence, data, loc);
+	append(&unacked, Udp_unacked{reliable_sequence, slice.clone(scratch[:]), time.tick_now()});
+	reliable_sequence += 1;
+
+	_udp_send_datagram(channel, scratch[:]);
+}
+
+//Reads everything recived, resends unacked messages and sends the delayed (shim) datagrams, it does not block.
+udp_channel_poll :: proc (using channel : ^Udp_channel) {
+	tracy.Zone();
+
+	lock(&mutex);
+	defer unlock(&mutex);
+
+	datagram : [Udp_max_datagram]u8;
+
+	for {
+		bytes_recv, from, err := net.recv_udp(socket, datagram[:]);
+		if err != nil || bytes_recv == 0 {
+			break; //Would block (or a transient error), nothing more for now.
+		}
+
+		if remote.port == 0 {
+			remote = from;
+		}
+		else if from != remote {
+			continue;
+		}
+
+		_udp_handle_datagram(channel, datagram[:bytes_recv]);
+	}
+
+	if should_ack {
+		should_ack = false;
+		clear(&scratch);
+		utils.append_type_to_data(Udp_header{Udp_protocol_id, .ack, reliable_next - 1}, &scratch);
+		_udp_send_datagram(channel, scratch[:]);
+	}
+
+	now := time.tick_now();
+
+	for &u in unacked {
+		if time.tick_diff(u.last_sent, now) >= config.resend_interval {
+			u.last_sent = now;
+			resent += 1;
+			_udp_send_datagram(channel, u.data);
+		}
+	}
+
+	//Send the datagrams the shim held back, if there time has come.
+	for i := 0; i < len(delayed); {
+		if time.tick_diff(delayed[i].send_at, now) >= 0 {
+			_udp_send_raw(channel, delayed[i].data);
+			delete(delayed[i].data);
+			unordered_remove(&delayed, i);
+		}
+		else {
+			i += 1;
+		}
+	}
+}
+
+//Pops the next recived command, free it with destroy_command.
+udp_pop_command :: proc (using channel : ^Udp_channel) -> (com : Command, ok : bool) {
+	lock(&mutex);
+	defer unlock(&mutex);
+
+	if queue.len(recv_commands) == 0 {
+		return {}, false;
+	}
+
+	return queue.pop_front(&recv_commands), true;
+}
+
+//true if a is newer then b, this handles the sequence wrapping around.
+udp_sequence_newer :: #force_inline proc (a, b : u32) -> bool {
+	return cast(i32)(a - b) > 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+//Encodes the header and message into scratch.
+@(private)
+_udp_encode :: proc (using channel : ^Udp_channel, kind : Udp_packet_kind, sequence : u32, data : any, loc := #caller_location) {
+	clear(&scratch);
+	utils.append_type_to_data(Udp_header{Udp_protocol_id, kind, sequence}, &scratch);
+	err := encode_message(params, data, &scratch, loc);
+	fmt.assertf(err == .ok, "Failed to encode %v, err : %v", data.id, err, loc = loc);
+	fmt.assertf(len(scratch) <= Udp_max_datagram, "The message %v is %i bytes, that is above the max datagram size of %i", data.id, len(scratch), Udp_max_datagram, loc = loc);
+}
+
+//Sends through the shim.
+@(private)
+_udp_send_datagram :: proc (using channel : ^Udp_channel, data : []u8) {
+
+	if config.shim.loss > 0 && _udp_random(channel) < config.shim.loss {
+		shim_dropped += 1;
+		return;
+	}
+
+	if config.shim.latency > 0 || config.shim.jitter > 0 {
+		delay := config.shim.latency + cast(time.Duration)(cast(f32)config.shim.jitter * _udp_random(channel));
+		append(&delayed, Udp_delayed{time.tick_add(time.tick_now(), delay), slice.clone(data)});
+		return;
+	}
+
+	_udp_send_raw(channel, data);
+}
+
+@(private)
+_udp_send_raw :: proc (using channel : ^Udp_channel, data : []u8) {
+	if remote.port == 0 {
+		return; //We do not know who to send to yet.
+	}
+
+	_, err := net.send_udp(socket, data, remote);
+	if err != nil {
+		fmt.printf("Failed to send udp datagram, err : %v\n", err);
+	}
+}
+
+//xorshift, returns 0 to 1.
+@(private)
+_udp_random :: proc (using channel : ^Udp_channel) -> f32 {
+	rng_state ~= rng_state << 13;
+	rng_state ~= rng_state >> 7;
+	rng_state ~= rng_state << 17;
+	return cast(f32)(rng_state >> 40) / cast(f32)(1 << 24);
+}
+
+@(private)
+_udp_handle_datagram :: proc (using channel : ^Udp_channel, datagram : []u8) {
+	tracy.Zone();
+
+	if len(datagram) < size_of(Udp_header) {
+		return;
+	}
+	header := utils.to_type(datagram, Udp_header);
+	if header.protocol != Udp_protocol_id {
+		return;
+	}
+	message := datagram[size_of(Udp_header):];
+
+	switch header.kind {
+		case .unreliable:
+			_udp_deliver(channel, message, header.sequence);
+
+		case .reliable:
+			should_ack = true;
+
+			if header.sequence == reliable_next {
+				_udp_deliver(channel, message, nil);
+				reliable_next += 1;
+
+				//Deliver the ones that was waiting for this one.
+				for {
+					data, found := out_of_order[reliable_next];
+					if !found {
+						break;
+					}
+					_udp_deliver(channel, data, nil);
+					delete(data);
+					delete_key(&out_of_order, reliable_next);
+					reliable_next += 1;
+				}
+			}
+			else if udp_sequence_newer(header.sequence, reliable_next) && header.sequence - reliable_next < Udp_reliable_window {
+				if !(header.sequence in out_of_order) {
+					out_of_order[header.sequence] = slice.clone(message);
+				}
+			}
+			//Else it is a duplicate, it is acked again (the ack might have been lost).
+
+		case .ack:
+			for i := 0; i < len(unacked); {
+				if !udp_sequence_newer(unacked[i].sequence, header.sequence) {
+					delete(unacked[i].data);
+					ordered_remove(&unacked, i);
+				}
+				else {
+					i += 1;
+				}
+			}
+	}
+}
+
+//Decodes a single message (message id and payload) into a command, sequence is nil for reliable messages.
+@(private)
+_udp_deliver :: proc (using channel : ^Udp_channel, message : []u8, sequence : Maybe(u32)) {
+
+	if len(message) < size_of(message_id_type) {
+		return;
+	}
+
+	message_id := utils.to_type(message, message_id_type);
+	index := params.command_index[message_id];
+	if index == 0 {
+		fmt.printf("A none valid message %v was recived over udp.\n", message_id);
+		return;
+	}
+	info := &params.command_infos[index - 1];
+
+	seq, sequenced := sequence.?;
+	if sequenced && command_bitset_get(has_recived, info.index) && !udp_sequence_newer(seq, latest_recived[info.index]) {
+		stale_dropped += 1;
+		return;
+	}
+
+	if !command_bitset_get(allowed_commands, info.index) {
+		fmt.printf("The command : %v is not allowed over udp, dropping it.\n", info.type);
+		return;
+	}
+
+	payload := message[size_of(message_id_type):];
+
+	command : Command;
+	command.arena_alloc = arena_pool_get(&arena_pool);
+	command.pool = &arena_pool;
+	command.alloc = mem_virtual.arena_allocator(command.arena_alloc);
+	command.owns_memory = true;
+	command.is_constant_size = info.is_trivial;
+
+	if info.is_trivial {
+		if len(payload) != info.size {
+			invalid_dropped += 1;
+			destroy_command(command);
+			return;
+		}
+		command_data, err := mem.alloc_bytes(info.size, allocator = command.alloc);
+		if err != nil { panic("Unable to allocate!!?!?"); }
+		if info.size > 0 {
+			mem.copy(raw_data(command_data), raw_data(payload), info.size);
+		}
+		command.value = {data = raw_data(command_data), id = info.type};
+	}
+	else {
+		val : any;
+		err : utils.Serialization_error;
+		if info.compact {
+			val, err = utils.deserialize_from_bytes_compact(info.type, payload, command.alloc);
+		}
+		else {
+			val, err = utils.deserialize_from_bytes(info.type, payload, command.alloc);
+		}
+		if err != .ok {
+			fmt.printf("Failed to deserialize %v from udp, err : %v\n", info.type, err);
+			invalid_dropped += 1;
+			destroy_command(command);
+			return;
+		}
+		command.value = val;
+	}
+
+	//Only a message we could decode counts as the latest, so a broken datagram does not make the valid ones after it stale.
+	if sequenced {
+		command_bitset_set(has_recived, info.index, true);
+		latest_recived[info.index] = seq;
+	}
+
+	queue.append(&recv_commands, command);
+
+	for new_command in info.allowing {
+		command_bitset_set(allowed_commands, new_command, true);
+	}
+	for to_remove_command in info.disallowing {
+		command_bitset_set(allowed_commands, to_remove_command, false);
+	}
+}
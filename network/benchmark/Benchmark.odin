@@ -0,0 +1,412 @@
+package main
+
+//Loopback load test, spins up a Server and many Clients in this process and reports throughput, latency, server CPU, threads and memory.
+//Run with : odin run network/benchmark -o:speed -- -clients=64 -rate=1000 -seconds=5 -constant_ratio=0.8 -var_bytes=128 -mode=reactor
+//Every option is -name=value, see Config.
+
+import "core:c"
+import "core:fmt"
+import "core:net"
+import "core:os"
+import "core:slice"
+import "core:strconv"
+import "core:strings"
+import "core:time"
+
+import "base:intrinsics"
+
+import "core:container/queue"
+
+import "../../network"
+import "../../utils"
+import thread "../../utils"
+
+//Constant size command.
+Bench_small :: struct {
+	sent_at : i64,			//unix nanoseconds, the server and the clients share the clock.
+	client : u32,
+	seq : u32,
+	payload : [4]f32,
+}
+
+//Variable size command.
+Bench_large :: struct {
+	sent_at : i64,
+	client : u32,
+	text : string,
+	values : [dynamic]u32,
+}
+
+Config :: struct {
+	clients : int,
+	rate : int,					//Messages per second per client.
+	seconds : f64,
+	constant_ratio : f64,		//The part of the messages that are Bench_small, the rest are Bench_large.
+	var_bytes : int,			//The payload size of Bench_large.
+	mode : network.Server_mode,
+	reactor_threads : int,		//0 means half the core count.
+	sender_threads : int,		//The threads driving the clients, 0 means min(clients, 8).
+	send_queues : bool,
+	port : int,
+}
+
+Default_config :: Config{
+	clients = 32,
+	rate = 1000,
+	seconds = 5,
+	constant_ratio = 0.8,
+	var_bytes = 128,
+	mode = .thread_per_client,
+	reactor_threads = 0,
+	sender_threads = 0,
+	send_queues = false,
+	port = 26700,
+}
+
+Sender :: struct {
+	config : ^Config,
+	clients : []network.Client,
+	first_client : int,
+	sent : int,
+	cpu_time : time.Duration,	//The CPU used by this thread, it is not server CPU.
+	should_stop : ^bool,
+}
+
+Drain :: struct {
+	server : ^network.Server,
+	recived : int,			//atomic
+	latencies : [dynamic]i64,
+	should_stop : bool,
+}
+
+when ODIN_OS == .Linux {
+	foreign import libc_bench "system:c"
+
+	@(private)
+	Timespec :: struct {
+		sec : c.long,
+		nsec : c.long,
+	}
+
+	@(private)
+	Rusage :: struct {
+		utime : Timeval,
+		stime : Timeval,
+		_ : [14]c.long,
+	}
+
+	@(private)
+	Timeval :: struct {
+		sec : c.long,
+		usec : c.long,
+	}
+
+	@(private) CLOCK_THREAD_CPUTIME_ID :: 3;
+	@(private) RUSAGE_SELF :: 0;
+
+	@(default_calling_convention="c", private)
+	foreign libc_bench {
+		@(link_name="clock_gettime")	_clock_gettime	:: proc(clock : c.int, ts : ^Timespec) -> c.int ---
+		@(link_name="getrusage")		_getrusage		:: proc(who : c.int, usage : ^Rusage) -> c.int ---
+	}
+
+	thread_cpu_time :: proc () -> time.Duration {
+		ts : Timespec;
+		_clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+		return cast(time.Duration)(cast(i64)ts.sec * 1e9 + cast(i64)ts.nsec);
+	}
+
+	process_cpu_time :: proc () -> time.Duration {
+		usage : Rusage;
+		_getrusage(RUSAGE_SELF, &usage);
+		us := cast(i64)(usage.utime.sec + usage.stime.sec) * 1e6 + cast(i64)(usage.utime.usec + usage.stime.usec);
+		return cast(time.Duration)(us * 1e3);
+	}
+
+	//Reads a "Name:   value" line from /proc/self/status.
+	proc_status_value :: proc (name : string) -> int {
+		data, ok := os.read_entire_file("/proc/self/status", context.temp_allocator);
+		if !ok {
+			return -1;
+		}
+		text := string(data);
+		for line in strings.split_lines_iterator(&text) {
+			if strings.has_prefix(line, name) {
+				fields := strings.fields(line[len(name):], context.temp_allocator);
+				if len(fields) != 0 {
+					v, _ := strconv.parse_int(fields[0]);
+					return v;
+				}
+			}
+		}
+		return -1;
+	}
+}
+else {
+	thread_cpu_time :: proc () -> time.Duration { return 0; }
+	process_cpu_time :: proc () -> time.Duration { return 0; }
+	proc_status_value :: proc (name : string) -> int { return -1; }
+}
+
+parse_config :: proc (args : []string) -> (config : Config, ok : bool) {
+	config = Default_config;
+
+	for arg in args {
+		parts := strings.split_n(strings.trim_left(arg, "-"), "=", 2, context.temp_allocator);
+		if len(parts) != 2 {
+			fmt.printf("Expected -name=value, got %v\n", arg);
+			return config, false;
+		}
+		name, value := parts[0], parts[1];
+
+		switch name {
+			case "clients":			config.clients = strconv.parse_int(value) or_return;
+			case "rate":			config.rate = strconv.parse_int(value) or_return;
+			case "seconds":			config.seconds = strconv.parse_f64(value) or_return;
+			case "constant_ratio":	config.constant_ratio = strconv.parse_f64(value) or_return;
+			case "var_bytes":		config.var_bytes = strconv.parse_int(value) or_return;
+			case "reactor_threads":	config.reactor_threads = strconv.parse_int(value) or_return;
+			case "sender_threads":	config.sender_threads = strconv.parse_int(value) or_return;
+			case "send_queues":		config.send_queues = strconv.parse_bool(value) or_return;
+			case "port":			config.port = strconv.parse_int(value) or_return;
+			case "mode":
+				switch value {
+					case "thread":		config.mode = .thread_per_client;
+					case "reactor":		config.mode = .reactor;
+					case:
+						fmt.printf("Unknown mode %v, expected thread or reactor\n", value);
+						return config, false;
+				}
+			case:
+				fmt.printf("Unknown option %v\n", name);
+				return config, false;
+		}
+	}
+
+	if config.sender_threads <= 0 {
+		config.sender_threads = min(config.clients, 8);
+	}
+
+	return config, true;
+}
+
+//Paces the messages of its clients, so every client sends config.rate messages per second.
+sender_proc : thread.Thread_Proc : proc (t : ^thread.Thread) {
+	sender := cast(^Sender)t.data;
+	config := sender.config;
+
+	cpu_start := thread_cpu_time();
+
+	text := strings.repeat("x", max(config.var_bytes - 64, 0));
+	defer delete(text);
+	values := make([dynamic]u32, min(config.var_bytes, 64) / size_of(u32));
+	defer delete(values);
+
+	total_rate := config.rate * len(sender.clients);
+	interval := time.Second / cast(time.Duration)max(total_rate, 1);
+	next := time.tick_now();
+
+	//A deterministic mix, so every run sends the same sequence.
+	mix_acc : f64 = 0;
+	next_client := 0;
+
+	for !intrinsics.atomic_load(sender.should_stop) {
+		now := time.tick_now();
+		for time.tick_diff(next, now) >= 0 && !intrinsics.atomic_load(sender.should_stop) {
+			client := &sender.clients[next_client];
+			client_index := cast(u32)(sender.first_client + next_client);
+			sent_at := time.to_unix_nanoseconds(time.now());
+
+			mix_acc += config.constant_ratio;
+			if mix_acc >= 1 {
+				mix_acc -= 1;
+				network.send_message(client, Bench_small{sent_at, client_index, cast(u32)sender.sent, {1, 2, 3, 4}});
+			}
+			else {
+				network.send_message(client, Bench_large{sent_at, client_index, text, values});
+			}
+
+			sender.sent += 1;
+			next_client = (next_client + 1) % len(sender.clients);
+			next = time.tick_add(next, interval);
+		}
+		time.sleep(200 * time.Microsecond);
+	}
+
+	sender.cpu_time = thread_cpu_time() - cpu_start;
+}
+
+//Consumes every command the server recives and records the one way latency.
+drain_proc : thread.Thread_Proc : proc (t : ^thread.Thread) {
+	drain := cast(^Drain)t.data;
+	server := drain.server;
+
+	for !intrinsics.atomic_load(&drain.should_stop) {
+		utils.lock(&server.clients_mutex);
+		for _, client in server.clients {
+			utils.lock(&client.commands_mutex);
+			now := time.to_unix_nanoseconds(time.now());
+			for queue.len(client.recv_commands) != 0 {
+				com := queue.pop_front(&client.recv_commands);
+				switch v in com.value {
+					case Bench_small:
+						append(&drain.latencies, now - v.sent_at);
+					case Bench_large:
+						append(&drain.latencies, now - v.sent_at);
+				}
+				network.destroy_command(com);
+				intrinsics.atomic_add(&drain.recived, 1);
+			}
+			utils.unlock(&client.commands_mutex);
+		}
+		utils.unlock(&server.clients_mutex);
+		time.sleep(50 * time.Microsecond);
+	}
+}
+
+percentile :: proc (sorted : []i64, p : f64) -> time.Duration {
+	if len(sorted) == 0 {
+		return 0;
+	}
+	return cast(time.Duration)sorted[min(cast(int)(cast(f64)len(sorted) * p), len(sorted) - 1)];
+}
+
+main :: proc () {
+	config, ok := parse_config(os.args[1:]);
+	if !ok {
+		os.exit(1);
+	}
+
+	commands_map : map[network.message_id_type]typeid = {
+		1 = Bench_small,
+		2 = Bench_large,
+	};
+	defer delete(commands_map);
+	server_allowed : network.typeid_set = { Bench_small = {}, Bench_large = {} };
+	defer delete(server_allowed);
+	client_allowed : network.typeid_set;
+	no_list : map[typeid][]typeid;
+
+	server_params := network.make_params(proc(to_clean : any) {}, commands_map, server_allowed, no_list, no_list);
+	defer network.delete_params(&server_params);
+	client_params := network.make_params(proc(to_clean : any) {}, commands_map, client_allowed, no_list, no_list);
+	defer network.delete_params(&client_params);
+	if config.send_queues {
+		network.enable_send_queues(&server_params);
+		network.enable_send_queues(&client_params);
+	}
+
+	fmt.printf("%#v\n", config);
+
+	baseline_threads := proc_status_value("Threads:");
+
+	endpoint := net.Endpoint{net.IP4_Loopback, config.port};
+	server : network.Server;
+	network.make_server(&server, server_params, endpoint, config.mode, config.reactor_threads);
+
+	drain := Drain{server = &server, latencies = make([dynamic]i64)};
+	defer delete(drain.latencies);
+	drain_thread := thread.create(drain_proc, &drain);
+	thread.start(drain_thread);
+
+	clients := make([]network.Client, config.clients);
+	defer delete(clients);
+	for &client in clients {
+		network.make_client(&client, client_params);
+		network.Connect_client(&client, endpoint);
+	}
+
+	//Wait for the server to accept everyone, so we do not measure the connecting.
+	for {
+		utils.lock(&server.clients_mutex);
+		connected := len(server.clients);
+		utils.unlock(&server.clients_mutex);
+		if connected >= config.clients {
+			break;
+		}
+		time.sleep(time.Millisecond);
+	}
+
+	should_stop := false;
+	senders := make([]Sender, config.sender_threads);
+	defer delete(senders);
+	sender_threads := make([]^thread.Thread, config.sender_threads);
+	defer delete(sender_threads);
+
+	per_sender := (config.clients + config.sender_threads - 1) / config.sender_threads;
+	for &sender, i in senders {
+		first := min(i * per_sender, config.clients);
+		last := min(first + per_sender, config.clients);
+		sender = {config = &config, clients = clients[first:last], first_client = first, should_stop = &should_stop};
+	}
+
+	cpu_start := process_cpu_time();
+	wall : time.Stopwatch;
+	time.stopwatch_start(&wall);
+
+	for &sender, i in senders {
+		if len(sender.clients) == 0 {
+			continue;
+		}
+		sender_threads[i] = thread.create(sender_proc, &sender);
+		thread.start(sender_threads[i]);
+	}
+
+	//Sample the threads and memory while the load runs.
+	peak_threads := 0;
+	peak_rss_kb := 0;
+	run_time := cast(time.Duration)(config.seconds * cast(f64)time.Second);
+	for time.stopwatch_duration(wall) < run_time {
+		peak_threads = max(peak_threads, proc_status_value("Threads:"));
+		peak_rss_kb = max(peak_rss_kb, proc_status_value("VmRSS:"));
+		free_all(context.temp_allocator);
+		time.sleep(100 * time.Millisecond);
+	}
+
+	intrinsics.atomic_store(&should_stop, true);
+	total_sent := 0;
+	sender_cpu : time.Duration;
+	for &sender, i in senders {
+		if sender_threads[i] != nil {
+			thread.destroy(sender_threads[i]);
+			free(sender_threads[i]);
+		}
+		total_sent += sender.sent;
+		sender_cpu += sender.cpu_time;
+	}
+
+	//Let the server catch up with what is in flight.
+	drain_deadline := time.tick_add(time.tick_now(), 5 * time.Second);
+	for intrinsics.atomic_load(&drain.recived) < total_sent && time.tick_diff(time.tick_now(), drain_deadline) > 0 {
+		time.sleep(time.Millisecond);
+	}
+	time.stopwatch_stop(&wall);
+	cpu_total := process_cpu_time() - cpu_start;
+
+	intrinsics.atomic_store(&drain.should_stop, true);
+	thread.destroy(drain_thread);
+	free(drain_thread);
+
+	recived := intrinsics.atomic_load(&drain.recived);
+	elapsed := time.duration_seconds(time.stopwatch_duration(wall));
+	slice.sort(drain.latencies[:]);
+
+	//Everything but the sender threads is the server (and the idle client recive threads).
+	server_cpu := cpu_total - sender_cpu;
+
+	fmt.printf("sent %i, recived %i in %.2f s\n", total_sent, recived, elapsed);
+	fmt.printf("throughput : %.0f messages/s\n", cast(f64)recived / elapsed);
+	fmt.printf("latency : p50 %v, p95 %v, p99 %v, max %v\n",
+		percentile(drain.latencies[:], 0.50), percentile(drain.latencies[:], 0.95), percentile(drain.latencies[:], 0.99), percentile(drain.latencies[:], 1));
+	if recived != 0 {
+		fmt.printf("server cpu : %v total, %.2f us per message (senders used %v)\n", server_cpu, time.duration_microseconds(server_cpu) / cast(f64)recived, sender_cpu);
+	}
+	fmt.printf("threads : %i before, %i peak\n", baseline_threads, peak_threads);
+	fmt.printf("memory : %i KB peak rss, %i KB high water\n", peak_rss_kb, proc_status_value("VmHWM:"));
+
+	for &client in clients {
+		network.close_client(&client);
+	}
+	server.should_close = true;
+	network.close_server(&server);
+}
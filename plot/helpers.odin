@@ -31,123 +31,55 @@ read_csv_file_as_signal :: proc (filepath : string, begin_row := 0, end_row := m
 @require_results
 read_csv_data_as_signal :: proc (csv_data : string, begin_row : int = 0, end_row := max(int), x_columb := 0, y_columb := 1, resample := false, loc := #caller_location) -> (signal : Signal) {
 	
-	ordinate := make([dynamic]f64, loc = loc); //y-coordinate
-	abscissa := make([dynamic]f64, loc = loc); //x-coordinate
-		
-	cur_ordinate : f64;
-	cur_abscissa : f64;
-	cur_entry : [dynamic]rune;
-	cur_columb : int = 0; 
-	cur_exp_entry : [dynamic]rune;
-	cur_exp : f64;
-	cur_row : int = 0;
-	defer delete(cur_entry);
-	defer delete(cur_exp_entry);
+	assert(csv_data != "", "csv_data is empty");
 	
-	State :: enum {
-		reading,
-		found_surfix,
-		parse_exponent,
-	}
-	state : State = .reading;
+	//Only the rows from begin_row up to end_row are parsed.
+	first := _csv_row_start(csv_data, 0, begin_row);
+	last := _csv_row_start(csv_data, first, end_row - begin_row);
+	rows := csv_data[first:last];
 	
-	assert(csv_data != "", "csv_data is empty");
-	for r in csv_data {
-		
-		if cur_row < begin_row {
-			if r == '\n' {
-				cur_row += 1;
-			}
-			continue;
+	//The rows are split in chunks that end at a newline, they are parsed in parallel and joined in order.
+	chunk_count := clamp(len(rows) / Csv_chunk_bytes, 1, utils.Parallel_max_chunks);
+	chunks := make([]Csv_chunk, chunk_count, context.temp_allocator);
+	start := 0;
+	for &c, i in chunks {
+		end := len(rows);
+		if i != chunk_count - 1 {
+			end = _csv_row_start(rows, max(start, len(rows) * (i + 1) / chunk_count), 1);
 		}
-		if cur_row >= end_row {
-			break;
+		c = {data = rows[start:end], all = csv_data, offset = first + start, x_columb = x_columb, y_columb = y_columb};
+		start = end;
+	}
+	
+	utils.parallel_for({0, chunk_count}, 1, &chunks, proc (chunks : ^[]Csv_chunk, begin, end : int) {
+		for &c in chunks[begin:end] {
+			_parse_csv_rows(&c);
 		}
-		
-		if state == .found_surfix {
-			fmt.assertf(r == ',' || r == ' ' || r == '\n', "surfix must be at the last charactor, found %v after %v at line %i", r, cur_entry[len(cur_entry)-1], cur_row);
-			panic("found surfix... todo?");
+	});
+	
+	//The parsing stops at the first empty entry, so the chunks after it are not used (and their errors are not raised).
+	total := 0;
+	for c in chunks {
+		if c.error != "" {
+			fmt.panicf("%v", c.error);
 		}
-		
-		read : bool = true;
-		if state == .parse_exponent {
-			if r == '\n' || r == ',' || r == ' ' {
-				s := utf8.runes_to_string(cur_exp_entry[:], context.temp_allocator);
-				cur_exp = strconv.atof(s);
-				state = .reading;
-				clear(&cur_exp_entry);
-			}
-			else {
-				append(&cur_exp_entry, r);
-				read = false;
-			}
+		total += len(c.ordinate);
+		if c.stopped {
+			break;
 		}
-		
-		if read {
-			if r == '\n' || r == ',' {
-				s := utf8.runes_to_string(cur_entry[:], context.temp_allocator);
-				if cur_columb == y_columb {
-					cur_ordinate = strconv.atof(s) * math.pow10(cur_exp);
-				}
-				if cur_columb == x_columb {
-					cur_abscissa = strconv.atof(s) * math.pow10(cur_exp);
-				}
-				clear(&cur_entry);
-				cur_exp = 0;
-				state = .reading;
-				
-				if r == ',' {
-					cur_columb += 1;
-				}
-				if r == '\n' {
-					append(&ordinate, cur_ordinate, loc = loc);
-					append(&abscissa, cur_abscissa, loc = loc);
-					cur_columb = 0;
-					cur_row += 1;
-				}
-			}
-			else if unicode.is_number(r) || r == '.' || r == '-' {
-				append(&cur_entry, r);
-			}
-			else if unicode.is_letter(r) {
-				if state == .found_surfix {
-					fmt.panicf("Invalid entry at line %i, seems to be a string not a number.", cur_row);
-				}
-				if r == 'E' {
-					state = .parse_exponent;
-					continue;
-				}
-				switch r {
-					case 'p': 
-						cur_exp = (-12);
-					case 'n':
-						cur_exp = (-9);
-					case 'u', 'µ':
-						cur_exp = (-6);
-					case 'm':
-						cur_exp = (-3);
-					case 'k':
-						cur_exp = 3;
-					case 'M':
-						cur_exp = 6;
-					case 'G':
-						cur_exp = 9;
-					case 'T':
-						cur_exp = 12;
-					case:
-						fmt.panicf("Invalid surfix %v, found at line %v", r, cur_row);
-				}
-				state = .found_surfix;
-			}
-			else {
-				if r == ' ' {
-					break; //Once there is an empty entry we break.
-				}
-				else {
-					fmt.panicf("unknown symbol : %v at line %i", r, cur_row);
-				}
-			}
+	}
+	ordinate := make([dynamic]f64, 0, total, loc = loc); //y-coordinate
+	abscissa := make([dynamic]f64, 0, total, loc = loc); //x-coordinate
+	stopped := false;
+	for c in chunks {
+		if !stopped {
+			append(&ordinate, ..c.ordinate[:], loc = loc);
+			append(&abscissa, ..c.abscissa[:], loc = loc);
+			stopped = c.stopped;
 		}
+		delete(c.ordinate);
+		delete(c.abscissa);
+		delete(c.error);
 	}
 	
 	assert(len(ordinate) == len(abscissa), "ordinate and abscissa must have same length, internal passing error.");
@@ -251,4 +183,160 @@ read_csv_row_as_strings :: proc (data : string, begin_row := 0, end_row := max(i
 	
 	return values[:];
 }
-*/
\ No newline at end of file
+*/
+/////////////////////////////////////////////////////////////////////////////////////
+
+//The csv data is split in chunks of about this size, smaller data is parsed serially.
+@(private="file")
+Csv_chunk_bytes :: 64 * 1024;
+
+@(private="file")
+Csv_chunk :: struct {
+	data : string,
+	all : string,				//The whole csv data and where the chunk is in it, only used to find the line for the errors.
+	offset : int,
+	x_columb, y_columb : int,
+	
+	ordinate, abscissa : [dynamic]f64,
+	stopped : bool,				//An empty entry was found, nothing after it is used.
+	error : string,				//The chunk stopped at invalid data, only raised if no chunk before it stopped.
+}
+
+//The byte index rows lines after start, or len(data) if there are not that many.
+@(private="file")
+_csv_row_start :: proc (data : string, start : int, rows : int) -> int {
+	pos := start;
+	for _ in 0..<rows {
+		i := strings.index_byte(data[pos:], '\n');
+		if i == -1 {
+			return len(data);
+		}
+		pos += i + 1;
+	}
+	return pos;
+}
+
+@(private="file")
+_csv_line :: proc (c : ^Csv_chunk, cur_row : int) -> int {
+	return strings.count(c.all[:c.offset], "\n") + cur_row;
+}
+
+@(private="file")
+_parse_csv_rows :: proc (c : ^Csv_chunk) {
+	using c;
+	
+	cur_ordinate : f64;
+	cur_abscissa : f64;
+	cur_entry : [dynamic]u8;
+	cur_columb : int = 0; 
+	cur_exp_entry : [dynamic]u8;
+	cur_exp : f64;
+	cur_row : int = 0;
+	defer delete(cur_entry);
+	defer delete(cur_exp_entry);
+	
+	State :: enum {
+		reading,
+		found_surfix,
+		parse_exponent,
+	}
+	state : State = .reading;
+	
+	for r in data {
+		
+		if state == .found_surfix {
+			if !(r == ',' || r == ' ' || r == '\n') {
+				error = fmt.aprintf("surfix must be at the last charactor, found %v after %v at line %i", r, string(cur_entry[:]), _csv_line(c, cur_row));
+			}
+			else {
+				error = fmt.aprintf("found surfix... todo?");
+			}
+			return;
+		}
+		
+		read : bool = true;
+		if state == .parse_exponent {
+			if r == '\n' || r == ',' || r == ' ' {
+				cur_exp = strconv.atof(string(cur_exp_entry[:]));
+				state = .reading;
+				clear(&cur_exp_entry);
+			}
+			else {
+				bytes, n := utf8.encode_rune(r);
+				append(&cur_exp_entry, ..bytes[:n]);
+				read = false;
+			}
+		}
+		
+		if read {
+			if r == '\n' || r == ',' {
+				s := string(cur_entry[:]);
+				if cur_columb == y_columb {
+					cur_ordinate = strconv.atof(s) * math.pow10(cur_exp);
+				}
+				if cur_columb == x_columb {
+					cur_abscissa = strconv.atof(s) * math.pow10(cur_exp);
+				}
+				clear(&cur_entry);
+				cur_exp = 0;
+				state = .reading;
+				
+				if r == ',' {
+					cur_columb += 1;
+				}
+				if r == '\n' {
+					append(&ordinate, cur_ordinate);
+					append(&abscissa, cur_abscissa);
+					cur_columb = 0;
+					cur_row += 1;
+				}
+			}
+			else if unicode.is_number(r) || r == '.' || r == '-' {
+				bytes, n := utf8.encode_rune(r);
+				append(&cur_entry, ..bytes[:n]);
+			}
+			else if unicode.is_letter(r) {
+				if state == .found_surfix {
+					error = fmt.aprintf("Invalid entry at line %i, seems to be a string not a number.", _csv_line(c, cur_row));
+					return;
+				}
+				if r == 'E' {
+					state = .parse_exponent;
+					continue;
+				}
+				switch r {
+					case 'p': 
+						cur_exp = (-12);
+					case 'n':
+						cur_exp = (-9);
+					case 'u', 'µ':
+						cur_exp = (-6);
+					case 'm':
+						cur_exp = (-3);
+					case 'k':
+						cur_exp = 3;
+					case 'M':
+						cur_exp = 6;
+					case 'G':
+						cur_exp = 9;
+					case 'T':
+						cur_exp = 12;
+					case:
+						error = fmt.aprintf("Invalid surfix %v, found at line %v", r, _csv_line(c, cur_row));
+						return;
+				}
+				state = .found_surfix;
+			}
+			else {
+				if r == ' ' {
+					stopped = true;
+					break; //Once there is an empty entry we break.
+				}
+				else {
+					error = fmt.aprintf("unknown symbol : %v at line %i", r, _csv_line(c, cur_row));
+					return;
+				}
+			}
+		}
+	}
+}
@@ -6,10 +6,10 @@ import "core:math"
 import "core:math/cmplx"
 import "core:unicode/utf8"
 import "core:slice"
-import "core:thread"
-import "core:os"
 import "core:log"
 
+import "../utils"
+
 PRINT_DFT_PROCENT :: true;
 
 @(require_results)
@@ -94,11 +94,8 @@ calculate_complex_dft :: proc (times : []f64, values : []f64, use_hertz := true,
 	phasors = make([]complex128, high - low);
 	freqs = make([]f64, high - low);	
 	
-	thread_count := math.max(1, os.processor_core_count()-1);
-	
-	pool : thread.Pool;
-	thread.pool_init(&pool, context.allocator, thread_count);
-	defer thread.pool_destroy(&pool);
+	//The work is split in a few chunks per worker, so the workers that finish first steal the rest.
+	thread_count := (utils.jobs_worker_count() + 1) * 4;
 	
 	Task_info :: struct {
 		times, values, freqs : []f64,
@@ -177,17 +174,17 @@ calculate_complex_dft :: proc (times : []f64, values : []f64, use_hertz := true,
 		}
 	}
 	
-	calc_task : thread.Task_Proc : proc (task: thread.Task) {
-		t : ^Task_info = auto_cast task.data;
+	calc_job : utils.Job_proc : proc (data : rawptr) {
+		t : ^Task_info = auto_cast data;
 		calculate_freq_content(t^);
 	}
 	
+	group := utils.job_group();
 	for &t in tasks {
-		thread.pool_add_task(&pool, context.allocator, calc_task, &t);
+		utils.job_spawn(calc_job, &t, group);
 	}
-	
-	thread.pool_start(&pool);
-	thread.pool_finish(&pool);
+	utils.job_run(group);
+	utils.job_wait(group);
 	
 	return;
 }
@@ -122,30 +122,49 @@ Mesh_combine_data :: struct(T: typeid) {
 
 combine_mesh_data_multi :: proc ($T : typeid, mesh_datas : []Mesh_combine_data(T), loc := #caller_location) -> (res_verts : []T, res_indices : Indices) {
 	
+	//The result is allocated once and every mesh is transformed into its place.
+	vert_offsets := make([]int, len(mesh_datas) + 1, context.temp_allocator);
+	index_offsets := make([]int, len(mesh_datas) + 1, context.temp_allocator);
+	
+	for m, i in mesh_datas {
+		t2 := reflect.union_variant_type_info(m.indices);
+		t1 := reflect.union_variant_type_info(mesh_datas[0].indices);
+		fmt.assertf(t1 == t2, "indicies does not match, type 1 was %v, and type 2 was: %v", t1, t2);
+		
+		vert_offsets[i + 1] = vert_offsets[i] + len(m.verts);
+		index_offsets[i + 1] = index_offsets[i] + indices_len(m.indices);
+	}
+	
+	res_verts = make([]T, vert_offsets[len(mesh_datas)], loc = loc);
 	switch ind in mesh_datas[0].indices {
 		case nil:
 			res_indices = nil;
 		case []u16:
-			res_indices = make([]u16,0);
+			res_indices = make([]u16, index_offsets[len(mesh_datas)]);
 		case []u32:
-			res_indices = make([]u32,0);
+			res_indices = make([]u32, index_offsets[len(mesh_datas)]);
 	}
 	
-	for m, i in mesh_datas {
-				
-		t2 := reflect.union_variant_type_info(m.indices);
-		t1 := reflect.union_variant_type_info(res_indices);
-		fmt.assertf(t1 == t2, "indicies does not match, type 1 was %v, and type 2 was: %v", t1, t2);
+	for m, mesh in mesh_datas {
+		for v, j in m.verts {
+			v := v;
+			v.position = (m.transform * [4]f32{v.position.x, v.position.y, v.position.z, 1}).xyz;
+			res_verts[vert_offsets[mesh] + j] = v;
+		}
 		
-		new_verts, new_indices := combine_mesh_data(1, res_verts, res_indices, m.transform, m.verts, m.indices, loc = loc);
-		if res_verts != nil {
-			delete(res_verts);
+		switch dst in res_indices {
+			case nil:
+			case []u16:
+				for index, j in m.indices.([]u16) {
+					dst[index_offsets[mesh] + j] = index + auto_cast vert_offsets[mesh];
+				}
+			case []u32:
+				for index, j in m.indices.([]u32) {
+					dst[index_offsets[mesh] + j] = index + auto_cast vert_offsets[mesh];
+				}
 		}
-		indices_delete(res_indices);
-		res_verts = new_verts; 
-		res_indices = new_indices;
 	}
-
+	
 	return;
 }
 
@@ -246,4 +246,28 @@ destroy_tracking_allocators :: proc() -> (found_leak : bool) {
 	}
 
 	return;
-}
\ No newline at end of file
+}
+
+//Counts the allocations and resizes that go through it, the work is done by the backing allocator.
+//Not thread safe, it is meant for tests and benchmarks that check a path does not allocate.
+Counting_allocator :: struct {
+	backing : mem.Allocator,
+	allocations : int,
+}
+
+@(require_results)
+counting_allocator :: proc (data : ^Counting_allocator) -> mem.Allocator {
+	return mem.Allocator{
+		data = data,
+		procedure = counting_allocator_proc,
+	};
+}
+
+counting_allocator_proc :: proc (allocator_data : rawptr, mode : mem.Allocator_Mode, size, alignment : int, old_memory : rawptr, old_size : int, loc := #caller_location) -> ([]byte, mem.Allocator_Error) {
+	c := cast(^Counting_allocator)allocator_data;
+	#partial switch mode {
+		case .Alloc, .Alloc_Non_Zeroed, .Resize, .Resize_Non_Zeroed:
+			c.allocations += 1;
+	}
+	return c.backing.procedure(c.backing.data, mode, size, alignment, old_memory, old_size, loc);
+}
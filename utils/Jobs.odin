@@ -0,0 +1,418 @@
+package utils;
+
+import "core:os"
+import "core:sync"
+import "core:time"
+import "base:intrinsics"
+import "base:runtime"
+import base_thread "core:thread"
+
+import "../tracy"
+
+//A process wide job system, so render, plot, nn and network code share one set of worker threads instead of each making a pool.
+//Every worker (and every registered thread) has its own deque, it pushes and pops its own jobs at the bottom and idle workers steal from the top of the others (Chase-Lev).
+//Threads that are not registered hand their jobs to a shared lock-free queue, so any thread can make jobs.
+//A job can have a parent, the parent is done when it and all its children are, so a parent with no procedure is a group to wait on.
+//job_wait executes other jobs while it waits, so waiting in a job does not block a worker.
+//The temp_allocator of a worker is freed after every job it runs, so a job must not return temp memory.
+//
+//The handles are slots in a ring of Jobs_ring_size jobs, a handle is valid until that many more jobs are made (wait on it before then).
+//A job (or group) that is made must also be run, a slot is only reused when its job is done, so one that is never run stops the ring (job_create asserts on it).
+
+Job_proc :: #type proc (data : rawptr);
+
+Job :: struct {
+	procedure : Job_proc,
+	data : rawptr,
+	parent : ^Job,
+	unfinished : int,			//atomic, 1 for the job itself and 1 for every child that is not done
+	submitted : bool,			//atomic, set by job_run
+}
+
+Job_handle :: ^Job;
+
+Jobs_ring_size :: 1 << 14;
+Jobs_deque_size :: 1 << 12;
+Jobs_max_registered :: 16;		//The threads other then the workers that can have their own deque.
+Jobs_inject_size :: 1 << 12;
+
+@(private="file")
+Job_deque :: struct {
+	jobs : []^Job,
+	_ : [64]u8,
+	top : int,					//atomic, stolen from
+	_ : [64]u8,
+	bottom : int,				//atomic, only the owner pushes and pops here
+	_ : [64]u8,
+}
+
+@(private="file")
+Job_worker :: struct {
+	deque : Job_deque,
+	thread : ^Thread,			//nil for the registered threads
+	rng : u64,
+}
+
+@(private="file")
+Job_system :: struct {
+	workers : []Job_worker,		//The worker threads first, then the registered threads
+	worker_count : int,
+	registered : int,			//atomic
+	inject : Mpmc_queue(^Job),	//The jobs of threads without a deque
+
+	ring : []Job,
+	ring_next : int,			//atomic
+
+	running : bool,				//atomic
+	sleeping : int,				//atomic
+	wake : sync.Sema,
+}
+
+@(private="file")
+jobs : Job_system;
+@(private="file")
+jobs_once : sync.Once;
+
+@(thread_local, private="file")
+job_slot : int;					//The index of this threads worker + 1, 0 if it has no deque
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+//Starts the job system, the calling thread is registered. It is started with the default worker count on first use if this is not called.
+//0 workers means the core count minus one.
+jobs_init :: proc (worker_count := 0) {
+	Init_data :: struct { worker_count : int };
+	data := Init_data{worker_count};
+	sync.once_do_with_data(&jobs_once, proc (data : rawptr) {
+		_jobs_start((cast(^Init_data)data).worker_count);
+	}, &data);
+
+	jobs_register_thread();
+}
+
+//Stops the workers, only call it when no jobs are made or running anymore (at exit).
+jobs_shutdown :: proc () {
+	if !intrinsics.atomic_load(&jobs.running) {
+		return;
+	}
+
+	intrinsics.atomic_store(&jobs.running, false);
+	sync.sema_post(&jobs.wake, jobs.worker_count);
+
+	context.allocator = runtime.heap_allocator();
+	for &w in jobs.workers[:jobs.worker_count] {
+		join(w.thread);
+		destroy(w.thread);
+		free(w.thread);
+	}
+	for &w in jobs.workers {
+		delete(w.deque.jobs);
+	}
+	delete(jobs.workers);
+	delete(jobs.ring);
+	mpmc_destroy(&jobs.inject);
+
+	jobs = {};
+	jobs_once = {};
+	job_slot = 0;
+}
+
+//The amount of worker threads, the threads that help with job_wait are not counted.
+jobs_worker_count :: proc () -> int {
+	_jobs_ensure();
+	return jobs.worker_count;
+}
+
+//Gives the calling thread its own deque, a long lived thread that makes many jobs (like the render thread) should call this, returns false if there is no room.
+jobs_register_thread :: proc () -> bool {
+	_jobs_ensure();
+
+	if job_slot != 0 {
+		return true;
+	}
+	index := intrinsics.atomic_add(&jobs.registered, 1);
+	if index >= Jobs_max_registered {
+		return false;
+	}
+	job_slot = jobs.worker_count + index + 1;
+	return true;
+}
+
+//Makes a job, it is not run until job_run. If there is a parent, the parent is not done until this job is.
+job_create :: proc (procedure : Job_proc, data : rawptr = nil, parent : Job_handle = nil) -> Job_handle {
+	_jobs_ensure();
+
+	index := intrinsics.atomic_add(&jobs.ring_next, 1) & (Jobs_ring_size - 1);
+	job := &jobs.ring[index];
+
+	//The slot is reused, if the old job is still not done (far to many jobs in flight) we help until it is.
+	//If it was never run it will never be done.
+	for intrinsics.atomic_load(&job.unfinished) != 0 {
+		assert(intrinsics.atomic_load(&job.submitted), "A job was made but never run (job_run), its slot in the ring can not be reused");
+		_help_once();
+	}
+
+	if parent != nil {
+		intrinsics.atomic_add(&parent.unfinished, 1);
+	}
+	job.procedure = procedure;
+	job.data = data;
+	job.parent = parent;
+	intrinsics.atomic_store(&job.submitted, false);
+	intrinsics.atomic_store(&job.unfinished, 1);
+
+	return job;
+}
+
+//A job with no procedure, make jobs with it as parent and wait on it. Remember to job_run it.
+job_group :: proc (parent : Job_handle = nil) -> Job_handle {
+	return job_create(nil, nil, parent);
+}
+
+//Submits the job, it might run on any worker (or on a thread that is waiting).
+job_run :: proc (job : Job_handle) {
+	intrinsics.atomic_store(&job.submitted, true);
+
+	if job_slot != 0 {
+		if !_deque_push(&jobs.workers[job_slot - 1].deque, job) {
+			_job_execute(job); //The deque is full, so we do it now.
+			return;
+		}
+	}
+	else {
+		if !mpmc_push(&jobs.inject, job) {
+			_job_execute(job);
+			return;
+		}
+	}
+
+	if intrinsics.atomic_load(&jobs.sleeping) > 0 {
+		sync.sema_post(&jobs.wake);
+	}
+}
+
+//job_create and job_run.
+job_spawn :: proc (procedure : Job_proc, data : rawptr = nil, parent : Job_handle = nil) -> Job_handle {
+	job := job_create(procedure, data, parent);
+	job_run(job);
+	return job;
+}
+
+job_is_done :: #force_inline proc (job : Job_handle) -> bool {
+	return intrinsics.atomic_load(&job.unfinished) == 0;
+}
+
+//Waits until the job and its children are done, the calling thread executes other jobs meanwhile.
+job_wait :: proc (job : Job_handle) {
+	tracy.Zone();
+
+	spins := 0;
+	for !job_is_done(job) {
+		if _help_once() {
+			spins = 0;
+		}
+		else {
+			spins += 1;
+			if spins > 64 {
+				base_thread.yield();
+			}
+			else {
+				intrinsics.cpu_relax();
+			}
+		}
+	}
+}
+
+//Executes one job if there is one, returns false if there was nothing to do. For a thread that waits on something else then a job (like the task graph does).
+job_help :: proc () -> bool {
+	_jobs_ensure();
+	return _help_once();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+@(private="file")
+_jobs_ensure :: #force_inline proc () {
+	if !intrinsics.atomic_load(&jobs.running) {
+		sync.once_do(&jobs_once, proc () {
+			_jobs_start(0);
+		});
+	}
+}
+
+@(private="file")
+_jobs_start :: proc (worker_count : int) {
+	context.allocator = runtime.heap_allocator();
+
+	count := worker_count;
+	if count <= 0 {
+		count = max(1, os.processor_core_count() - 1);
+	}
+
+	jobs.worker_count = count;
+	jobs.workers = make([]Job_worker, count + Jobs_max_registered);
+	for &w, i in jobs.workers {
+		w.deque.jobs = make([]^Job, Jobs_deque_size);
+		w.rng = cast(u64)i * 0x9E3779B97F4A7C15 + 1;
+	}
+	jobs.ring = make([]Job, Jobs_ring_size);
+	mpmc_init(&jobs.inject, Jobs_inject_size);
+
+	intrinsics.atomic_store(&jobs.running, true);
+
+	for i in 0..<count {
+		t := create(_worker_proc, nil, i);
+		jobs.workers[i].thread = t;
+		start(t);
+	}
+}
+
+@(private="file")
+_worker_proc :: proc (t : ^Thread) {
+	job_slot = t.user_index + 1;
+
+	for intrinsics.atomic_load(&jobs.running) {
+		//Nothing on the stack uses the temp memory of the job here, so it is freed after every job.
+		if _help_once() {
+			free_all(context.temp_allocator);
+			continue;
+		}
+
+		//Nothing to do, spin a little and then sleep until a job is run.
+		found := false;
+		for _ in 0..<256 {
+			intrinsics.cpu_relax();
+			if _help_once() {
+				free_all(context.temp_allocator);
+				found = true;
+				break;
+			}
+		}
+		if !found {
+			intrinsics.atomic_add(&jobs.sleeping, 1);
+			sync.sema_wait_with_timeout(&jobs.wake, time.Millisecond);
+			intrinsics.atomic_sub(&jobs.sleeping, 1);
+		}
+	}
+}
+
+//Executes one job if there is one, our own first, then the shared queue, then stolen.
+@(private="file")
+_help_once :: proc () -> bool {
+	job := _find_job();
+	if job == nil {
+		return false;
+	}
+	_job_execute(job);
+	return true;
+}
+
+@(private="file")
+_find_job :: proc () -> ^Job {
+	if job_slot != 0 {
+		if job := _deque_pop(&jobs.workers[job_slot - 1].deque); job != nil {
+			return job;
+		}
+	}
+
+	if job, ok := mpmc_pop(&jobs.inject); ok {
+		return job;
+	}
+
+	//Steal, starting at a random worker.
+	victims := jobs.worker_count + min(intrinsics.atomic_load(&jobs.registered), Jobs_max_registered);
+	start := 0;
+	if job_slot != 0 {
+		w := &jobs.workers[job_slot - 1];
+		w.rng ~= w.rng << 13;
+		w.rng ~= w.rng >> 7;
+		w.rng ~= w.rng << 17;
+		start = cast(int)(w.rng % cast(u64)victims);
+	}
+	for i in 0..<victims {
+		victim := (start + i) % victims;
+		if victim == job_slot - 1 {
+			continue;
+		}
+		if job := _deque_steal(&jobs.workers[victim].deque); job != nil {
+			return job;
+		}
+	}
+
+	return nil;
+}
+
+@(private="file")
+_job_execute :: proc (job : ^Job) {
+	if job.procedure != nil {
+		job.procedure(job.data);
+	}
+	_job_finish(job);
+}
+
+@(private="file")
+_job_finish :: proc (job : ^Job) {
+	//Once unfinished is 0 the slot can be reused by job_create, so the parent is read before.
+	parent := job.parent;
+	if intrinsics.atomic_sub(&job.unfinished, 1) == 1 && parent != nil {
+		_job_finish(parent);
+	}
+}
+
+//Only the owner pushes, returns false if it is full.
+@(private="file")
+_deque_push :: proc (d : ^Job_deque, job : ^Job) -> bool {
+	b := intrinsics.atomic_load_explicit(&d.bottom, .Relaxed);
+	t := intrinsics.atomic_load_explicit(&d.top, .Acquire);
+	if b - t >= len(d.jobs) {
+		return false;
+	}
+
+	intrinsics.atomic_store_explicit(&d.jobs[b & (len(d.jobs) - 1)], job, .Relaxed);
+	intrinsics.atomic_thread_fence(.Release);
+	intrinsics.atomic_store_explicit(&d.bottom, b + 1, .Relaxed);
+	return true;
+}
+
+//Only the owner pops, from the bottom (the newest job).
+@(private="file")
+_deque_pop :: proc (d : ^Job_deque) -> ^Job {
+	b := intrinsics.atomic_load_explicit(&d.bottom, .Relaxed) - 1;
+	intrinsics.atomic_store_explicit(&d.bottom, b, .Relaxed);
+	intrinsics.atomic_thread_fence(.Seq_Cst);
+	t := intrinsics.atomic_load_explicit(&d.top, .Relaxed);
+
+	if t > b {
+		//Empty
+		intrinsics.atomic_store_explicit(&d.bottom, b + 1, .Relaxed);
+		return nil;
+	}
+
+	job := intrinsics.atomic_load_explicit(&d.jobs[b & (len(d.jobs) - 1)], .Relaxed);
+	if t == b {
+		//The last one, a thief might take it at the same time.
+		if _, ok := intrinsics.atomic_compare_exchange_strong_explicit(&d.top, t, t + 1, .Seq_Cst, .Relaxed); !ok {
+			job = nil;
+		}
+		intrinsics.atomic_store_explicit(&d.bottom, b + 1, .Relaxed);
+	}
+	return job;
+}
+
+//Any thread steals, from the top (the oldest job).
+@(private="file")
+_deque_steal :: proc (d : ^Job_deque) -> ^Job {
+	t := intrinsics.atomic_load_explicit(&d.top, .Acquire);
+	intrinsics.atomic_thread_fence(.Seq_Cst);
+	b := intrinsics.atomic_load_explicit(&d.bottom, .Acquire);
+
+	if t >= b {
+		return nil;
+	}
+
+	job := intrinsics.atomic_load_explicit(&d.jobs[t & (len(d.jobs) - 1)], .Relaxed);
+	if _, ok := intrinsics.atomic_compare_exchange_strong_explicit(&d.top, t, t + 1, .Seq_Cst, .Relaxed); !ok {
+		return nil; //Someone else got it.
+	}
+	return job;
+}
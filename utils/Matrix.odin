@@ -157,20 +157,25 @@ matrix_mul :: #force_inline proc(A, B : Matrix($T), loc := #caller_location) ->
 		data = make([]T, A.rows * B.columns, loc = loc), // Flattened 2D matrix with zeros, as Odin is zero-init
 	};
 
-	// Perform matrix multiplication
-	for i in 0 ..< A.rows {
-		for j in 0 ..< B.columns {
-			sum : T;
-			
-			for k in 0 ..< A.columns {
-				// Access elements in flattened arrays
-				a_elem := A.data[i * A.columns + k];
-				b_elem := B.data[k * B.columns + j];
-				sum += a_elem * b_elem;
+	// Perform matrix multiplication, the rows are done in parallel (a grain is about 64k multiplications, so small matrices stay serial).
+	Mul_data :: struct { A, B, result : ^Matrix(T) };
+	A, B := A, B;
+	data := Mul_data{&A, &B, &result};
+	parallel_for({0, A.rows}, max(1, (1 << 16) / max(1, A.columns * B.columns)), &data, proc (using d : ^Mul_data, begin, end : int) {
+		for i in begin ..< end {
+			for j in 0 ..< B.columns {
+				sum : T;
+				
+				for k in 0 ..< A.columns {
+					// Access elements in flattened arrays
+					a_elem := A.data[i * A.columns + k];
+					b_elem := B.data[k * B.columns + j];
+					sum += a_elem * b_elem;
+				}
+				result.data[i * B.columns + j] = sum;
 			}
-			result.data[i * B.columns + j] = sum;
 		}
-	}
+	});
 
 	return result;
 }
@@ -0,0 +1,104 @@
+package utils;
+
+import "base:intrinsics"
+import "core:fmt"
+
+//A bounded lock-free queue, any number of threads can push and pop (Vyukov's bounded MPMC queue).
+//Every cell has a sequence number, a push/pop claims a position with a CAS and then waits for the cells sequence, so no locks are taken.
+Mpmc_queue :: struct($T : typeid) {
+	cells : []Mpmc_cell(T),
+	mask : int,
+
+	_ : [64]u8,			//Keep the producers and consumers positions on seperate cache lines.
+	enqueue_pos : int,	//atomic
+	_ : [64]u8,
+	dequeue_pos : int,	//atomic
+	_ : [64]u8,
+}
+
+Mpmc_cell :: struct($T : typeid) {
+	sequence : int,		//atomic
+	value : T,
+}
+
+//capacity must be a power of 2.
+mpmc_init :: proc (q : ^Mpmc_queue($T), capacity : int, alloc := context.allocator, loc := #caller_location) {
+	fmt.assertf(capacity >= 2 && capacity & (capacity - 1) == 0, "capacity must be a power of 2, it is %v", capacity, loc = loc);
+
+	q.cells = make([]Mpmc_cell(T), capacity, alloc, loc);
+	q.mask = capacity - 1;
+	for &c, i in q.cells {
+		c.sequence = i;
+	}
+	q.enqueue_pos = 0;
+	q.dequeue_pos = 0;
+}
+
+mpmc_destroy :: proc (q : ^Mpmc_queue($T), alloc := context.allocator) {
+	delete(q.cells, alloc);
+	q.cells = nil;
+}
+
+//Returns false if the queue is full.
+mpmc_push :: proc (q : ^Mpmc_queue($T), value : T) -> bool {
+	pos := intrinsics.atomic_load_explicit(&q.enqueue_pos, .Relaxed);
+
+	for {
+		cell := &q.cells[pos & q.mask];
+		seq := intrinsics.atomic_load_explicit(&cell.sequence, .Acquire);
+		diff := seq - pos;
+
+		if diff == 0 {
+			if _, ok := intrinsics.atomic_compare_exchange_weak_explicit(&q.enqueue_pos, pos, pos + 1, .Relaxed, .Relaxed); ok {
+				cell.value = value;
+				intrinsics.atomic_store_explicit(&cell.sequence, pos + 1, .Release);
+				return true;
+			}
+			pos = intrinsics.atomic_load_explicit(&q.enqueue_pos, .Relaxed);
+		}
+		else if diff < 0 {
+			return false; //full
+		}
+		else {
+			pos = intrinsics.atomic_load_explicit(&q.enqueue_pos, .Relaxed);
+		}
+	}
+}
+
+//Returns false if the queue is empty.
+mpmc_pop :: proc (q : ^Mpmc_queue($T)) -> (value : T, ok : bool) {
+	pos := intrinsics.atomic_load_explicit(&q.dequeue_pos, .Relaxed);
+
+	for {
+		cell := &q.cells[pos & q.mask];
+		seq := intrinsics.atomic_load_explicit(&cell.sequence, .Acquire);
+		diff := seq - (pos + 1);
+
+		if diff == 0 {
+			if _, cas_ok := intrinsics.atomic_compare_exchange_weak_explicit(&q.dequeue_pos, pos, pos + 1, .Relaxed, .Relaxed); cas_ok {
+				value = cell.value;
+				intrinsics.atomic_store_explicit(&cell.sequence, pos + q.mask + 1, .Release);
+				return value, true;
+			}
+			pos = intrinsics.atomic_load_explicit(&q.dequeue_pos, .Relaxed);
+		}
+		else if diff < 0 {
+			return {}, false; //empty
+		}
+		else {
+			pos = intrinsics.atomic_load_explicit(&q.dequeue_pos, .Relaxed);
+		}
+	}
+}
+
+//Pushes, spinning while the queue is full (someone must be popping).
+mpmc_push_wait :: proc (q : ^Mpmc_queue($T), value : T) {
+	for !mpmc_push(q, value) {
+		intrinsics.cpu_relax();
+	}
+}
+
+//An estimate, it might be off while other threads push or pop.
+mpmc_len :: proc (q : ^Mpmc_queue($T)) -> int {
+	return max(intrinsics.atomic_load(&q.enqueue_pos) - intrinsics.atomic_load(&q.dequeue_pos), 0);
+}
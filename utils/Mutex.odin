@@ -2,6 +2,7 @@ package utils;
 
 import "core:fmt"
 import "core:sync"
+import "core:time"
 import "base:runtime"
 
 TRACY_ENABLE 	:: #config(ODIN_DEBUG, false);
@@ -136,6 +137,24 @@ when LOCK_DEBUG || TRACY_ENABLE {
 	}
 
 	/////////////////
+
+	//The mutex must be locked, it is unlocked while waiting and locked again before returning. Returns false on timeout.
+	cond_wait_with_timeout :: proc(cond : ^sync.Cond, using mutex : ^Mutex, duration : time.Duration, loc := #caller_location) -> bool {
+		
+		sync.lock(&location_mutex);
+		locked_loc = {};
+		locking_thread = 0;
+		sync.unlock(&location_mutex);
+
+		res := sync.cond_wait_with_timeout(cond, mutex, duration);
+
+		sync.lock(&location_mutex);
+		locked_loc = loc;
+		locking_thread = sync.current_thread_id();
+		sync.unlock(&location_mutex);
+
+		return res;
+	}
 }
 else {
 	Mutex :: sync.Mutex;
@@ -150,4 +169,6 @@ else {
 	
 	lock_read :: sync.rw_mutex_shared_lock;
 	unlock_read :: sync.rw_mutex_shared_unlock;
+
+	cond_wait_with_timeout :: sync.cond_wait_with_timeout;
 }
@@ -0,0 +1,142 @@
+package utils;
+
+import "base:runtime"
+
+import "../tracy"
+
+//parallel_for and parallel_reduce split a range in chunks and run them as jobs (see Jobs.odin), the calling thread does the last chunk and then helps with the rest.
+//The body gets the callers context, except the temp_allocator, which is the one of the thread running the chunk (so it must not be returned, a worker frees it after the chunk).
+//Calls inside a body run serially, the outer loop already uses all the workers and splitting again only adds overhead.
+//If the range is not bigger then one grain it is also run serially, so a small input costs the same as a plain loop.
+
+Parallel_max_chunks :: 256;
+
+//The chunks are about this many per thread when the grain is 0, so the threads that finish first can steal from the slower ones.
+Parallel_chunks_per_thread :: 4;
+
+Parallel_body :: #type proc (data : rawptr, begin, end : int);
+
+@(private="file")
+Parallel_shared :: struct {
+	body : Parallel_body,
+	data : rawptr,
+	ctx : runtime.Context,
+}
+
+@(private="file")
+Parallel_chunk :: struct {
+	shared : ^Parallel_shared,
+	begin, end : int,
+}
+
+@(thread_local, private="file")
+parallel_depth : int;
+
+//Calls body(data, begin, end) for chunks of range (begin inclusive, end exclusive) in parallel, returns when all are done.
+//grain is the smallest chunk, 0 chooses it from the amount of workers. The chunks must not write to the same memory.
+parallel_for :: proc (range : [2]int, grain : int, data : ^$D, body : proc (data : ^D, begin, end : int)) {
+	_parallel_run(range, grain, data, transmute(Parallel_body)body);
+}
+
+//Like parallel_for, but every chunk returns a value and they are combined in order (combine(combine(identity, r0), r1)...), so the result does not depend on the scheduling.
+parallel_reduce :: proc (range : [2]int, grain : int, data : ^$D, identity : $R, body : proc (data : ^D, begin, end : int) -> R, combine : proc (a, b : R) -> R) -> R {
+
+	chunk_size, chunk_count := parallel_chunking(range, grain);
+	if chunk_count <= 1 {
+		if range[1] <= range[0] {
+			return identity;
+		}
+		return combine(identity, body(data, range[0], range[1]));
+	}
+
+	Reduce_data :: struct {
+		data : ^D,
+		body : proc (data : ^D, begin, end : int) -> R,
+		results : []R,
+		begin, chunk_size : int,
+	}
+
+	//On the heap, R can be big (an array or matrix) and there can be Parallel_max_chunks of them.
+	results := make([]R, chunk_count);
+	defer delete(results);
+	reduce := Reduce_data{data, body, results, range[0], chunk_size};
+
+	reduce_body :: proc (r : ^Reduce_data, begin, end : int) {
+		r.results[(begin - r.begin) / r.chunk_size] = r.body(r.data, begin, end);
+	}
+	_parallel_run(range, chunk_size, &reduce, transmute(Parallel_body)reduce_body);
+
+	res := identity;
+	for v in reduce.results {
+		res = combine(res, v);
+	}
+	return res;
+}
+
+//The size and amount of chunks range is split in, there are never more then Parallel_max_chunks.
+parallel_chunking :: proc (range : [2]int, grain : int) -> (chunk_size, chunk_count : int) {
+	count := range[1] - range[0];
+	if count <= 0 {
+		return 1, 0;
+	}
+
+	chunk_size = grain;
+	if chunk_size <= 0 {
+		chunk_size = count / ((jobs_worker_count() + 1) * Parallel_chunks_per_thread);
+	}
+	chunk_size = max(chunk_size, 1, (count + Parallel_max_chunks - 1) / Parallel_max_chunks);
+
+	if parallel_depth > 0 {
+		chunk_size = count;
+	}
+
+	chunk_count = (count + chunk_size - 1) / chunk_size;
+	return;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+@(private="file")
+_parallel_run :: proc (range : [2]int, grain : int, data : rawptr, body : Parallel_body) {
+	tracy.Zone();
+
+	chunk_size, chunk_count := parallel_chunking(range, grain);
+	if chunk_count == 0 {
+		return;
+	}
+	if chunk_count == 1 {
+		parallel_depth += 1;
+		body(data, range[0], range[1]);
+		parallel_depth -= 1;
+		return;
+	}
+
+	shared := Parallel_shared{body, data, context};
+	chunks : [Parallel_max_chunks]Parallel_chunk;
+
+	group := job_group();
+	for i in 0..<chunk_count {
+		begin := range[0] + i * chunk_size;
+		chunks[i] = {&shared, begin, min(begin + chunk_size, range[1])};
+		if i != chunk_count - 1 {
+			job_spawn(_parallel_chunk_job, &chunks[i], group);
+		}
+	}
+	job_run(group);
+
+	_parallel_chunk_job(&chunks[chunk_count - 1]);
+	job_wait(group);
+}
+
+@(private="file")
+_parallel_chunk_job :: proc (data : rawptr) {
+	chunk := cast(^Parallel_chunk)data;
+
+	temp := context.temp_allocator;
+	context = chunk.shared.ctx;
+	context.temp_allocator = temp;
+
+	parallel_depth += 1;
+	chunk.shared.body(chunk.shared.data, chunk.begin, chunk.end);
+	parallel_depth -= 1;
+}
@@ -3,6 +3,8 @@ package utils;
 import "core:fmt"
 import "core:reflect"
 import "core:mem"
+import "core:io"
+import "core:sync"
 import "base:runtime"
 
 Header_size_type :: u32;
@@ -19,7 +21,35 @@ serializen_table : map[typeid]Seri_info = {
 	string = {string_seri, string_deseri}
 };
 
+//The answers of is_trivial_copied, a type does not change while running so they are kept forever.
+@(private="file")
+trivial_cache : map[typeid]bool;
+@(private="file")
+trivial_cache_mutex : sync.RW_Mutex;
+
+//Returns true if the type can be serialized with a mem.copy, the result is cached so only the first call per type walks the type info.
 is_trivial_copied :: proc(t : typeid) -> bool {
+
+	sync.shared_lock(&trivial_cache_mutex);
+	res, found := trivial_cache[t];
+	sync.shared_unlock(&trivial_cache_mutex);
+
+	if found {
+		return res;
+	}
+
+	res = _is_trivial_copied(t); //The members are cached by the recursion.
+
+	context.allocator = runtime.heap_allocator();
+	sync.lock(&trivial_cache_mutex);
+	trivial_cache[t] = res;
+	sync.unlock(&trivial_cache_mutex);
+
+	return res;
+}
+
+@(private="file")
+_is_trivial_copied :: proc(t : typeid) -> bool {
 	using runtime;
 	
 	ti : ^Type_Info = type_info_of(t);
@@ -45,9 +75,9 @@ is_trivial_copied :: proc(t : typeid) -> bool {
 		case Type_Info_Boolean:
 			return true;
 		case Type_Info_Array:
-			return true;
+			return is_trivial_copied(info.elem.id);
 		case Type_Info_Enumerated_Array:
-			return true;
+			return is_trivial_copied(info.elem.id);
 		case Type_Info_Matrix:
 			return true;
 		case Type_Info_Enum:
@@ -56,11 +86,11 @@ is_trivial_copied :: proc(t : typeid) -> bool {
 			//TODO this might not allways be false, but I see no usecase for checking
 			return false;
 		case Type_Info_Bit_Set:
-			return false; //IDK IS it?
+			return true; //It is stored as its underlying integer.
 		case Type_Info_Bit_Field:
-			return false; //IDK IS it?
+			return true; //Same, the fields are bits of the backing integer.
 		case Type_Info_Simd_Vector:
-			return false; //IDK IS it?
+			return is_trivial_copied(info.elem.id); //Only integers, floats and bools can be elements, but check anyway.
 		case Type_Info_Type_Id:
 			return false; //I think this is, check later 
 		case Type_Info_String:
@@ -115,10 +145,117 @@ Serialization_error :: enum {
 	value_too_big,
 	custom_type_invalid_data,
 	allocation_error,
+	invalid_data,				//A union tag or length that does not fit the type or the data
+	buffer_too_small,
+	write_failed,
 }
 
 //Handels trivial, structs and unions, but does include the size as a u32, so only use for non-trivial structs or unions.
+//Uses the cached plan of the type, see Serialize_plan.odin. The size is computed first, so data is grown once.
 serialize_to_bytes :: proc(value : any, data : ^[dynamic]u8, loc := #caller_location) -> Serialization_error { //The header includes itself, and is the size type of Header_size_type
+	
+	plan := serialize_plan_of(value.id);
+	size, err := _serialized_size(plan, value);
+	if err != .ok {
+		return err;
+	}
+
+	at := len(data);
+	non_zero_resize(data, at + size);
+
+	err = _serialize_sized(plan, value, data[at:]);
+	if err != .ok {
+		resize(data, at); //Do not leave the unwritten bytes in data.
+	}
+	return err;
+}
+
+//The bytes serialize_to_bytes appends for the value, the header included.
+serialized_size :: proc(value : any) -> (size : int, err : Serialization_error) {
+	return _serialized_size(serialize_plan_of(value.id), value);
+}
+
+//Writes the same bytes as serialize_to_bytes into buf, nothing is allocated (unless a custom serializer does).
+//Returns .buffer_too_small and writes nothing if it does not fit, use serialized_size to know how much is needed.
+serialize_into :: proc(value : any, buf : []u8) -> (written : int, err : Serialization_error) {
+	
+	plan := serialize_plan_of(value.id);
+	size : int;
+	size, err = _serialized_size(plan, value);
+	if err != .ok {
+		return 0, err;
+	}
+	if size > len(buf) {
+		return 0, .buffer_too_small;
+	}
+
+	err = _serialize_sized(plan, value, buf[:size]);
+	if err != .ok {
+		return 0, err;
+	}
+	return size, .ok;
+}
+
+//Writes the same bytes as serialize_to_bytes to the writer, small values are staged on the stack.
+serialize_to_writer :: proc(value : any, w : io.Writer) -> (written : int, err : Serialization_error) {
+	
+	plan := serialize_plan_of(value.id);
+	size : int;
+	size, err = _serialized_size(plan, value);
+	if err != .ok {
+		return 0, err;
+	}
+
+	stack : [1024]u8;
+	buf : []u8 = stack[:size] if size <= len(stack) else make([]u8, size);
+	defer if size > len(stack) {
+		delete(buf);
+	}
+
+	err = _serialize_sized(plan, value, buf);
+	if err != .ok {
+		return 0, err;
+	}
+
+	n, w_err := io.write_full(w, buf);
+	if w_err != nil {
+		return n, .write_failed;
+	}
+	return n, .ok;
+}
+
+@(private="file")
+_serialized_size :: proc(plan : ^Serialize_plan, value : any) -> (size : int, err : Serialization_error) {
+	
+	payload : int;
+	payload, err = plan_serialized_size(plan, value.data);
+	if err != .ok {
+		return 0, err;
+	}
+
+	size = size_of(Header_size_type) + payload;
+	if size >= cast(int)max(Header_size_type) {
+		return 0, .value_too_big;
+	}
+	return size, .ok;
+}
+
+//buf must be exactly the serialized size.
+@(private="file")
+_serialize_sized :: proc(plan : ^Serialize_plan, value : any, buf : []u8) -> Serialization_error {
+	
+	header := cast(Header_size_type)len(buf);
+	mem.copy(&buf[0], &header, size_of(Header_size_type));
+
+	pos := size_of(Header_size_type);
+	err := run_serialize_plan_into(plan, value.data, buf, &pos);
+	assert(err != .ok || pos == len(buf), "The serialized size did not match what was written");
+
+	return err;
+}
+
+//The same as serialize_to_bytes, but walks the type info every call, it is kept to compare against.
+serialize_to_bytes_reflected :: proc(value : any, data : ^[dynamic]u8, loc := #caller_location) -> Serialization_error {
 	using runtime;
 	
 	header_index := len(data);
@@ -203,7 +340,46 @@ _serialize_to_bytes :: proc(value : any, data : ^[dynamic]u8, loc := #caller_loc
 }
 
 //One would have to free the memory with free(...) if one does not use a temp allocator.
+//Uses the cached plan of the type, see Serialize_plan.odin.
 deserialize_from_bytes :: proc(to_type : typeid, data : []u8, alloc : mem.Allocator, loc := #caller_location) -> (value : any, err : Serialization_error) {
+	return _deserialize_with_header(to_type, data, alloc, true, loc);
+}
+
+//The same as deserialize_from_bytes, but walks the type info every call, it is kept to compare against.
+deserialize_from_bytes_reflected :: proc(to_type : typeid, data : []u8, alloc : mem.Allocator, loc := #caller_location) -> (value : any, err : Serialization_error) {
+	return _deserialize_with_header(to_type, data, alloc, false, loc);
+}
+
+//Deserializes into one allocation, the value is at the start of the block and its strings and arrays are laid out after it.
+//Free it all with free(value.data, alloc). The arrays in it cannot grow (they have the nil allocator) and must not be deleted one by one.
+//The size is read from the bytes first, types with maps or custom serializers return .type_not_supported.
+deserialize_from_bytes_packed :: proc(to_type : typeid, data : []u8, alloc : mem.Allocator, loc := #caller_location) -> (value : any, err : Serialization_error) {
+	using runtime;
+
+	plan := serialize_plan_of(to_type);
+
+	footprint : int;
+	footprint, err = plan_packed_footprint(plan, data, size_of(Header_size_type));
+	if err != .ok {
+		return;
+	}
+
+	value_size := mem.align_forward_int(reflect.size_of_typeid(to_type), DEFAULT_ALIGNMENT);
+	block, a_err := mem.alloc_bytes(value_size + footprint, DEFAULT_ALIGNMENT, alloc, loc);
+	if a_err != nil {
+		err = .allocation_error;
+		return;
+	}
+
+	used_bytes : Header_size_type = size_of(Header_size_type);
+	err = run_deserialize_plan_packed(plan, data, &used_bytes, raw_data(block), block[value_size:], loc);
+	value = {data = raw_data(block), id = to_type};
+
+	return;
+}
+
+@(private="file")
+_deserialize_with_header :: proc(to_type : typeid, data : []u8, alloc : mem.Allocator, use_plan : bool, loc := #caller_location) -> (value : any, err : Serialization_error) {
 	using runtime;
 
 	context.allocator = mem.nil_allocator();
@@ -218,7 +394,12 @@ deserialize_from_bytes :: proc(to_type : typeid, data : []u8, alloc : mem.Alloca
 		return;
 	}
 
-	err = _deserialize_from_bytes(to_type, data, &used_bytes, value_data, alloc, loc);
+	if use_plan {
+		err = run_deserialize_plan(serialize_plan_of(to_type), data, &used_bytes, value_data, alloc, loc);
+	}
+	else {
+		err = _deserialize_from_bytes(to_type, data, &used_bytes, value_data, alloc, loc);
+	}
 	value = {data = value_data, id = to_type};
 
 	return;
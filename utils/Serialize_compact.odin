@@ -0,0 +1,772 @@
+package utils;
+
+import "core:mem"
+import "core:math"
+import "core:sync"
+import "core:reflect"
+import "core:strconv"
+import "base:runtime"
+import "base:intrinsics"
+
+//An opt-in compact wire format, for small chatty messages where most of the native format is padding and zero high bytes.
+//Lengths, integers, enums and union tags are LEB128 varints, signed values are zigzag encoded first so small negative values stay small.
+//Floats are copied as is, unless the field is tagged with a quantization step (`quant:"0.01"`), then round(value / step) is written as a signed varint.
+//A quant tag also applies to the floats of fixed arrays and structs in the field, but not to the elements of dynamic arrays, slices or maps.
+//The message still starts with the u32 size header, so it is framed like serialize_to_bytes, but the formats are not compatible, both ends must use the same.
+
+Compact_op_kind :: enum u8 {
+	copy,				//size bytes at offset
+	custom,				//a serializen_table hook, it writes its own (native) format
+	uvarint,			//an unsigned integer of size bytes
+	svarint,			//a signed integer of size bytes, zigzag encoded
+	quantized,			//a f32 or f64 (size) as a signed varint of value / step
+	string,
+	dynamic_array,
+	slice,
+	array,
+	union_value,
+	map_value,
+}
+
+//Like Plan_elem, raw elements contain no varints so a run of them is copied as is.
+Compact_elem :: struct {
+	type : typeid,
+	raw : bool,
+	size : int,
+	align : int,
+	plan : ^Compact_plan,		//atomic, nil until used
+}
+
+Compact_op :: struct {
+	kind : Compact_op_kind,
+	offset : int,
+	size : int,					//copy : the bytes to copy, integers/floats/union : the size of the value (tag)
+	count : int,				//array : the element count, union : the tag offset
+	step : f64,					//quantized
+	type : typeid,				//custom and map : the type
+	custom : Seri_info,
+	elem : Compact_elem,		//arrays : the element, map : the key
+	value : Compact_elem,		//map : the value
+	map_info : ^runtime.Map_Info,
+	variants : []Compact_elem,	//union
+	no_nil : bool,				//union
+}
+
+Compact_plan :: struct {
+	type : typeid,
+	err : Serialization_error,
+	ops : []Compact_op,
+}
+
+@(private="file")
+compact_cache : map[typeid]^Compact_plan;
+@(private="file")
+compact_cache_mutex : sync.RW_Mutex;
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+//The bytes serialize_to_bytes_compact appends for the value, the header included.
+compact_serialized_size :: proc (value : any) -> (size : int, err : Serialization_error) {
+	sink := Compact_sink{counting = true};
+	err = _compact_write(compact_plan_of(value.id), value.data, &sink);
+	if err != .ok {
+		return 0, err;
+	}
+
+	size = size_of(Header_size_type) + sink.pos;
+	if size >= cast(int)max(Header_size_type) {
+		return 0, .value_too_big;
+	}
+	return size, .ok;
+}
+
+//Writes the compact encoding with its header into buf, returns .buffer_too_small (and writes nothing) if it does not fit.
+serialize_compact_into :: proc (value : any, buf : []u8) -> (written : int, err : Serialization_error) {
+	size : int;
+	size, err = compact_serialized_size(value);
+	if err != .ok {
+		return 0, err;
+	}
+	if size > len(buf) {
+		return 0, .buffer_too_small;
+	}
+
+	header := cast(Header_size_type)size;
+	mem.copy(&buf[0], &header, size_of(Header_size_type));
+
+	sink := Compact_sink{buf = buf[:size], pos = size_of(Header_size_type)};
+	err = _compact_write(compact_plan_of(value.id), value.data, &sink);
+	if err != .ok {
+		return 0, err;
+	}
+	return size, .ok;
+}
+
+serialize_to_bytes_compact :: proc (value : any, data : ^[dynamic]u8) -> Serialization_error {
+	size, err := compact_serialized_size(value);
+	if err != .ok {
+		return err;
+	}
+
+	at := len(data);
+	non_zero_resize(data, at + size);
+	_, err = serialize_compact_into(value, data[at:]);
+	if err != .ok {
+		resize(data, at); //Do not leave the unwritten bytes in data.
+	}
+	return err;
+}
+
+//The compact version of deserialize_from_bytes, the value and what it points to are allocated with alloc.
+deserialize_from_bytes_compact :: proc (to_type : typeid, data : []u8, alloc : mem.Allocator, loc := #caller_location) -> (value : any, err : Serialization_error) {
+	context.allocator = mem.nil_allocator();
+
+	value_data, a_err := mem.alloc(reflect.size_of_typeid(to_type), runtime.DEFAULT_ALIGNMENT, alloc, loc);
+	if a_err != nil {
+		return {}, .allocation_error;
+	}
+
+	used := size_of(Header_size_type);
+	err = _compact_read(compact_plan_of(to_type), data, &used, value_data, alloc, loc);
+	value = {data = value_data, id = to_type};
+
+	return;
+}
+
+//Returns the cached compact plan for the type, it is made on first use.
+compact_plan_of :: proc (t : typeid) -> ^Compact_plan {
+
+	sync.shared_lock(&compact_cache_mutex);
+	plan, found := compact_cache[t];
+	sync.shared_unlock(&compact_cache_mutex);
+
+	if found {
+		return plan;
+	}
+
+	context.allocator = runtime.heap_allocator();
+
+	ops := make([dynamic]Compact_op);
+	new_plan := new(Compact_plan);
+	new_plan.type = t;
+	new_plan.err = _compact_append(&ops, type_info_of(t), 0, 0);
+	shrink(&ops);
+	new_plan.ops = ops[:];
+
+	sync.lock(&compact_cache_mutex);
+	defer sync.unlock(&compact_cache_mutex);
+
+	if existing, ok := compact_cache[t]; ok {
+		_delete_compact_plan(new_plan);
+		return existing;
+	}
+	compact_cache[t] = new_plan;
+
+	return new_plan;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+compact_put_uvarint :: #force_inline proc (buf : ^[10]u8, value : u64) -> int {
+	v := value;
+	i := 0;
+	for v >= 0x80 {
+		buf[i] = cast(u8)v | 0x80;
+		v >>= 7;
+		i += 1;
+	}
+	buf[i] = cast(u8)v;
+	return i + 1;
+}
+
+compact_get_uvarint :: #force_inline proc (data : []u8, used : ^int) -> (value : u64, ok : bool) {
+	shift : u64 = 0;
+	for _ in 0..<10 {
+		if used^ >= len(data) {
+			return 0, false;
+		}
+		b := data[used^];
+		used^ += 1;
+		value |= cast(u64)(b & 0x7F) << shift;
+		if b < 0x80 {
+			return value, true;
+		}
+		shift += 7;
+	}
+	return 0, false;
+}
+
+zigzag_encode :: #force_inline proc (v : i64) -> u64 {
+	return cast(u64)((v << 1) ~ (v >> 63));
+}
+
+zigzag_decode :: #force_inline proc (v : u64) -> i64 {
+	return cast(i64)(v >> 1) ~ -cast(i64)(v & 1);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+//Counts the bytes when counting, otherwise writes them into buf (which has room, it was counted first).
+@(private="file")
+Compact_sink :: struct {
+	buf : []u8,
+	pos : int,
+	counting : bool,
+}
+
+@(private="file")
+_sink_bytes :: #force_inline proc (sink : ^Compact_sink, src : rawptr, size : int) {
+	if !sink.counting && size != 0 {
+		dst := sink.buf[sink.pos:sink.pos + size];
+		mem.copy(raw_data(dst), src, size);
+	}
+	sink.pos += size;
+}
+
+@(private="file")
+_sink_uvarint :: #force_inline proc (sink : ^Compact_sink, value : u64) {
+	tmp : [10]u8;
+	n := compact_put_uvarint(&tmp, value);
+	_sink_bytes(sink, &tmp[0], n);
+}
+
+@(private="file")
+_load_uint :: #force_inline proc (src : rawptr, size : int) -> u64 {
+	switch size {
+		case 1: return cast(u64)(cast(^u8)src)^;
+		case 2: return cast(u64)(cast(^u16)src)^;
+		case 4: return cast(u64)(cast(^u32)src)^;
+		case 8: return (cast(^u64)src)^;
+	}
+	unreachable();
+}
+
+@(private="file")
+_load_sint :: #force_inline proc (src : rawptr, size : int) -> i64 {
+	switch size {
+		case 1: return cast(i64)(cast(^i8)src)^;
+		case 2: return cast(i64)(cast(^i16)src)^;
+		case 4: return cast(i64)(cast(^i32)src)^;
+		case 8: return (cast(^i64)src)^;
+	}
+	unreachable();
+}
+
+//Stores the low size bytes, so it works for both signed and unsigned.
+@(private="file")
+_store_int :: #force_inline proc (dst : rawptr, size : int, value : u64) {
+	switch size {
+		case 1: (cast(^u8)dst)^ = cast(u8)value;
+		case 2: (cast(^u16)dst)^ = cast(u16)value;
+		case 4: (cast(^u32)dst)^ = cast(u32)value;
+		case 8: (cast(^u64)dst)^ = value;
+		case: unreachable();
+	}
+}
+
+@(private="file")
+_compact_variant :: proc (op : ^Compact_op, tag : u64) -> (variant : ^Compact_elem, is_nil : bool, valid : bool) {
+	index := cast(int)tag;
+	if !op.no_nil {
+		if index == 0 {
+			return nil, true, true;
+		}
+		index -= 1;
+	}
+	if index < 0 || index >= len(op.variants) {
+		return nil, false, false;
+	}
+	return &op.variants[index], false, true;
+}
+
+@(private="file")
+_compact_elem_plan :: #force_inline proc (elem : ^Compact_elem) -> ^Compact_plan {
+	plan := intrinsics.atomic_load(&elem.plan);
+	if plan == nil {
+		plan = compact_plan_of(elem.type);
+		intrinsics.atomic_store(&elem.plan, plan);
+	}
+	return plan;
+}
+
+@(private="file")
+_compact_write :: proc (plan : ^Compact_plan, value : rawptr, sink : ^Compact_sink) -> Serialization_error {
+
+	if plan.err != .ok {
+		return plan.err;
+	}
+
+	for &op in plan.ops {
+		src : rawptr = _offset(value, op.offset);
+
+		switch op.kind {
+			case .copy:
+				_sink_bytes(sink, src, op.size);
+
+			case .custom:
+				scratch := make([dynamic]u8, context.temp_allocator);
+				op.custom.serialize(any{data = src, id = op.type}, &scratch);
+				_sink_bytes(sink, raw_data(scratch), len(scratch));
+
+			case .uvarint:
+				_sink_uvarint(sink, _load_uint(src, op.size));
+
+			case .svarint:
+				_sink_uvarint(sink, zigzag_encode(_load_sint(src, op.size)));
+
+			case .quantized:
+				f := cast(f64)(cast(^f32)src)^ if op.size == 4 else (cast(^f64)src)^;
+				_sink_uvarint(sink, zigzag_encode(cast(i64)math.round(f / op.step)));
+
+			case .string:
+				s := (cast(^string)src)^;
+				_sink_uvarint(sink, cast(u64)len(s));
+				_sink_bytes(sink, raw_data(s), len(s));
+
+			case .dynamic_array:
+				arr := cast(^runtime.Raw_Dynamic_Array)src;
+				_sink_uvarint(sink, cast(u64)arr.len);
+				if res := _compact_write_elems(&op.elem, arr.data, arr.len, sink); res != .ok {
+					return res;
+				}
+
+			case .slice:
+				sl := cast(^runtime.Raw_Slice)src;
+				_sink_uvarint(sink, cast(u64)sl.len);
+				if res := _compact_write_elems(&op.elem, sl.data, sl.len, sink); res != .ok {
+					return res;
+				}
+
+			case .array:
+				if res := _compact_write_elems(&op.elem, src, op.count, sink); res != .ok {
+					return res;
+				}
+
+			case .union_value:
+				tag := _load_uint(_offset(src, op.count), op.size);
+				_sink_uvarint(sink, tag);
+				variant, is_nil, valid := _compact_variant(&op, tag);
+				if !valid {
+					return .invalid_data;
+				}
+				if !is_nil {
+					if res := _compact_write_elems(variant, src, 1, sink); res != .ok {
+						return res;
+					}
+				}
+
+			case .map_value:
+				raw := cast(^runtime.Raw_Map)src;
+				_sink_uvarint(sink, cast(u64)raw.len);
+
+				it : int;
+				for k, v in reflect.iterate_map(any{data = src, id = op.type}, &it) {
+					if res := _compact_write_elems(&op.elem, k.data, 1, sink); res != .ok {
+						return res;
+					}
+					if res := _compact_write_elems(&op.value, v.data, 1, sink); res != .ok {
+						return res;
+					}
+				}
+		}
+	}
+
+	return .ok;
+}
+
+@(private="file")
+_compact_write_elems :: proc (elem : ^Compact_elem, src : rawptr, count : int, sink : ^Compact_sink) -> Serialization_error {
+	if elem.raw {
+		_sink_bytes(sink, src, count * elem.size);
+		return .ok;
+	}
+
+	plan := _compact_elem_plan(elem);
+	for i in 0..<count {
+		res := _compact_write(plan, _offset(src, i * elem.size), sink);
+		if res != .ok {
+			return res;
+		}
+	}
+	return .ok;
+}
+
+@(private="file")
+_compact_read :: proc (plan : ^Compact_plan, data : []u8, used : ^int, value : rawptr, alloc : mem.Allocator, loc := #caller_location) -> Serialization_error {
+
+	if plan.err != .ok {
+		return plan.err;
+	}
+
+	for &op in plan.ops {
+		dst : rawptr = _offset(value, op.offset);
+
+		switch op.kind {
+			case .copy:
+				if res := _read_raw(dst, data, used, op.size); res != .ok {
+					return res;
+				}
+
+			case .custom:
+				context.allocator = alloc;
+				n, s_err := op.custom.deserialize(any{data = dst, id = op.type}, data[used^:]);
+				used^ += cast(int)n;
+				if s_err {
+					return .custom_type_invalid_data;
+				}
+
+			case .uvarint:
+				v, ok := compact_get_uvarint(data, used);
+				if !ok {
+					return .invalid_data;
+				}
+				_store_int(dst, op.size, v);
+
+			case .svarint:
+				v, ok := compact_get_uvarint(data, used);
+				if !ok {
+					return .invalid_data;
+				}
+				_store_int(dst, op.size, cast(u64)zigzag_decode(v));
+
+			case .quantized:
+				v, ok := compact_get_uvarint(data, used);
+				if !ok {
+					return .invalid_data;
+				}
+				f := cast(f64)zigzag_decode(v) * op.step;
+				if op.size == 4 {
+					(cast(^f32)dst)^ = cast(f32)f;
+				}
+				else {
+					(cast(^f64)dst)^ = f;
+				}
+
+			case .string:
+				length, ok := compact_get_uvarint(data, used);
+				if !ok || length > cast(u64)(len(data) - used^) {
+					return .invalid_data;
+				}
+				s := cast(^runtime.Raw_String)dst;
+				s^ = {};
+				if length != 0 {
+					bytes, a_err := mem.alloc(cast(int)length, 1, alloc, loc);
+					if a_err != nil {
+						return .allocation_error;
+					}
+					mem.copy(bytes, &data[used^], cast(int)length);
+					s^ = {cast([^]u8)bytes, cast(int)length};
+				}
+				used^ += cast(int)length;
+
+			case .dynamic_array:
+				length, ok := _compact_read_length(&op.elem, data, used);
+				if !ok {
+					return .invalid_data;
+				}
+				context.allocator = alloc;
+				runtime.__dynamic_array_make(dst, op.elem.size, op.elem.align, length, length, loc);
+				arr := cast(^runtime.Raw_Dynamic_Array)dst;
+				if res := _compact_read_elems(&op.elem, data, used, arr.data, length, alloc, loc); res != .ok {
+					return res;
+				}
+
+			case .slice:
+				length, ok := _compact_read_length(&op.elem, data, used);
+				if !ok {
+					return .invalid_data;
+				}
+				sl := cast(^runtime.Raw_Slice)dst;
+				sl^ = {};
+				if length != 0 {
+					elems, a_err := mem.alloc(length * op.elem.size, op.elem.align, alloc, loc);
+					if a_err != nil {
+						return .allocation_error;
+					}
+					sl^ = {elems, length};
+				}
+				if res := _compact_read_elems(&op.elem, data, used, sl.data, length, alloc, loc); res != .ok {
+					return res;
+				}
+
+			case .array:
+				if res := _compact_read_elems(&op.elem, data, used, dst, op.count, alloc, loc); res != .ok {
+					return res;
+				}
+
+			case .union_value:
+				tag, ok := compact_get_uvarint(data, used);
+				if !ok {
+					return .invalid_data;
+				}
+				variant, is_nil, valid := _compact_variant(&op, tag);
+				if !valid {
+					return .invalid_data;
+				}
+				_store_int(_offset(dst, op.count), op.size, tag);
+				if !is_nil {
+					if res := _compact_read_elems(variant, data, used, dst, 1, alloc, loc); res != .ok {
+						return res;
+					}
+				}
+
+			case .map_value:
+				length, ok := compact_get_uvarint(data, used);
+				if !ok || length > cast(u64)(len(data) - used^) {
+					return .invalid_data;
+				}
+
+				raw := cast(^runtime.Raw_Map)dst;
+				raw^ = {};
+				raw.allocator = alloc;
+				if length == 0 {
+					continue;
+				}
+				if runtime.map_reserve_dynamic(raw, op.map_info, cast(uintptr)length, loc) != nil {
+					return .allocation_error;
+				}
+
+				value_offset := mem.align_forward_int(op.elem.size, op.value.align);
+				scratch, a_err := mem.alloc(value_offset + op.value.size, max(op.elem.align, op.value.align), alloc, loc);
+				if a_err != nil {
+					return .allocation_error;
+				}
+				defer mem.free(scratch, alloc);
+
+				for _ in 0..<length {
+					mem.zero(scratch, value_offset + op.value.size);
+					if res := _compact_read_elems(&op.elem, data, used, scratch, 1, alloc, loc); res != .ok {
+						return res;
+					}
+					if res := _compact_read_elems(&op.value, data, used, _offset(scratch, value_offset), 1, alloc, loc); res != .ok {
+						return res;
+					}
+					runtime.__dynamic_map_set_without_hash(raw, op.map_info, scratch, _offset(scratch, value_offset), loc);
+				}
+		}
+	}
+
+	return .ok;
+}
+
+//Every element takes at least a byte (unless it has no size), so a length longer then the rest of the data is invalid.
+@(private="file")
+_compact_read_length :: proc (elem : ^Compact_elem, data : []u8, used : ^int) -> (length : int, ok : bool) {
+	v := compact_get_uvarint(data, used) or_return;
+	if elem.size != 0 && v > cast(u64)(len(data) - used^) {
+		return 0, false;
+	}
+	return cast(int)v, true;
+}
+
+@(private="file")
+_compact_read_elems :: proc (elem : ^Compact_elem, data : []u8, used : ^int, dst : rawptr, count : int, alloc : mem.Allocator, loc := #caller_location) -> Serialization_error {
+	if elem.raw {
+		return _read_raw(dst, data, used, count * elem.size);
+	}
+
+	plan := _compact_elem_plan(elem);
+	for i in 0..<count {
+		res := _compact_read(plan, data, used, _offset(dst, i * elem.size), alloc, loc);
+		if res != .ok {
+			return res;
+		}
+	}
+	return .ok;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+@(private)
+_reset_compact_plans :: proc () {
+	sync.lock(&compact_cache_mutex);
+	defer sync.unlock(&compact_cache_mutex);
+
+	for _, plan in compact_cache {
+		_delete_compact_plan(plan);
+	}
+	delete(compact_cache);
+	compact_cache = nil;
+}
+
+@(private="file")
+_delete_compact_plan :: proc (plan : ^Compact_plan) {
+	for op in plan.ops {
+		delete(op.variants);
+	}
+	delete(plan.ops);
+	free(plan);
+}
+
+//Integers of platform endianness up to 64 bits are written as varints.
+@(private="file")
+_is_varint_integer :: proc (ti : ^runtime.Type_Info) -> (is_varint : bool, signed : bool) {
+	#partial switch info in runtime.type_info_base(ti).variant {
+		case runtime.Type_Info_Integer:
+			if info.endianness == .Platform && ti.size <= 8 {
+				return true, info.signed;
+			}
+		case runtime.Type_Info_Rune:
+			return true, true;
+		case runtime.Type_Info_Enum:
+			return _is_varint_integer(info.base);
+	}
+	return false, false;
+}
+
+//True if the type is written exactly as it is in memory.
+@(private="file")
+_compact_is_raw :: proc (ti : ^runtime.Type_Info) -> bool {
+	using runtime;
+
+	if !is_trivial_copied(ti.id) || ti.id in serializen_table {
+		return false;
+	}
+	if is_varint, _ := _is_varint_integer(ti); is_varint {
+		return false;
+	}
+
+	#partial switch info in type_info_base(ti).variant {
+		case Type_Info_Struct:
+			for i in 0..<info.field_count {
+				if _, has_quant := reflect.struct_tag_lookup(reflect.Struct_Tag(info.tags[i]), "quant"); has_quant {
+					return false;
+				}
+				if !_compact_is_raw(info.types[i]) {
+					return false;
+				}
+			}
+		case Type_Info_Array:
+			return _compact_is_raw(info.elem);
+		case Type_Info_Enumerated_Array:
+			return _compact_is_raw(info.elem);
+		case Type_Info_Union:
+			return false; //The tag is a varint
+	}
+	return true;
+}
+
+@(private="file")
+_compact_elem :: proc (ti : ^runtime.Type_Info) -> Compact_elem {
+	return {type = ti.id, raw = _compact_is_raw(ti), size = ti.size, align = ti.align};
+}
+
+//Appends the ops for a value of the type at offset, step is the quantization of the floats in it (0 for none).
+@(private="file")
+_compact_append :: proc (ops : ^[dynamic]Compact_op, ti : ^runtime.Type_Info, offset : int, step : f64) -> Serialization_error {
+	using runtime;
+
+	if hook, ok := serializen_table[ti.id]; ok && ti.id != string {
+		append(ops, Compact_op{kind = .custom, offset = offset, type = ti.id, custom = hook});
+		return .ok;
+	}
+
+	if step == 0 && _compact_is_raw(ti) {
+		_compact_append_copy(ops, offset, ti.size);
+		return .ok;
+	}
+
+	if is_varint, signed := _is_varint_integer(ti); is_varint {
+		append(ops, Compact_op{kind = .svarint if signed else .uvarint, offset = offset, size = ti.size});
+		return .ok;
+	}
+
+	base := type_info_base(ti);
+
+	#partial switch info in base.variant {
+		case Type_Info_Float:
+			if step != 0 && (ti.size == 4 || ti.size == 8) {
+				append(ops, Compact_op{kind = .quantized, offset = offset, size = ti.size, step = step});
+			}
+			else {
+				_compact_append_copy(ops, offset, ti.size);
+			}
+
+		case Type_Info_Struct:
+			for i in 0..<info.field_count {
+				field_step := step;
+				if quant, has_quant := reflect.struct_tag_lookup(reflect.Struct_Tag(info.tags[i]), "quant"); has_quant {
+					parsed, ok := strconv.parse_f64(quant);
+					if !ok || parsed <= 0 {
+						return .type_not_supported;
+					}
+					field_step = parsed;
+				}
+				res := _compact_append(ops, info.types[i], offset + cast(int)info.offsets[i], field_step);
+				if res != .ok {
+					return res;
+				}
+			}
+
+		case Type_Info_String:
+			if info.is_cstring {
+				return .type_not_supported;
+			}
+			append(ops, Compact_op{kind = .string, offset = offset});
+
+		case Type_Info_Dynamic_Array:
+			append(ops, Compact_op{kind = .dynamic_array, offset = offset, elem = _compact_elem(info.elem)});
+
+		case Type_Info_Slice:
+			append(ops, Compact_op{kind = .slice, offset = offset, elem = _compact_elem(info.elem)});
+
+		case Type_Info_Array, Type_Info_Enumerated_Array:
+			elem : ^Type_Info;
+			count : int;
+			#partial switch a in base.variant {
+				case Type_Info_Array:
+					elem, count = a.elem, a.count;
+				case Type_Info_Enumerated_Array:
+					elem, count = a.elem, a.count;
+			}
+
+			if step != 0 {
+				//Unrolled, the element plan does not know the step.
+				for i in 0..<count {
+					res := _compact_append(ops, elem, offset + i * elem.size, step);
+					if res != .ok {
+						return res;
+					}
+				}
+			}
+			else {
+				append(ops, Compact_op{kind = .array, offset = offset, count = count, elem = _compact_elem(elem)});
+			}
+
+		case Type_Info_Union:
+			if info.tag_type == nil || len(info.variants) == 0 {
+				return .type_not_supported;
+			}
+			variants := make([]Compact_elem, len(info.variants));
+			for v, i in info.variants {
+				variants[i] = _compact_elem(v);
+			}
+			append(ops, Compact_op{kind = .union_value, offset = offset, size = info.tag_type.size, count = cast(int)info.tag_offset, variants = variants, no_nil = info.no_nil});
+
+		case Type_Info_Map:
+			append(ops, Compact_op{kind = .map_value, offset = offset, type = ti.id, elem = _compact_elem(info.key), value = _compact_elem(info.value), map_info = info.map_info});
+
+		case:
+			if !is_trivial_copied(ti.id) {
+				return .type_not_supported;
+			}
+			_compact_append_copy(ops, offset, ti.size);
+	}
+
+	return .ok;
+}
+
+@(private="file")
+_compact_append_copy :: proc (ops : ^[dynamic]Compact_op, offset : int, size : int) {
+	if size == 0 {
+		return;
+	}
+	if len(ops) != 0 {
+		last := &ops[len(ops) - 1];
+		if last.kind == .copy && last.offset + last.size == offset {
+			last.size += size;
+			return;
+		}
+	}
+	append(ops, Compact_op{kind = .copy, offset = offset, size = size});
+}
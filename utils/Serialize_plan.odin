@@ -0,0 +1,819 @@
+package utils;
+
+import "core:mem"
+import "core:sync"
+import "core:reflect"
+import "base:runtime"
+import "base:intrinsics"
+
+//A serialization plan is the reflection of a type done once, serialize_to_bytes and deserialize_from_bytes run it instead of walking the type info every call.
+//The fields are flattened into a list of ops, neighbouring trivial fields are merged into one copy, so a struct of plain data is a single mem.copy.
+//The plans are cached per typeid for the lifetime of the program, for the types the reflected path (_serialize_to_bytes) handles the wire format is the same.
+//
+//The wire format per kind :
+//	trivial			the bytes as in memory
+//	string			the length as a u32, then the bytes (the same as string_seri)
+//	dynamic array	the length as an int, then the elements
+//	slice			the same as a dynamic array
+//	fixed array		the elements
+//	union			the tag as in memory, then the value of the variant (nothing for nil)
+//	map				the length as an int, then the key and value of every entry
+//Elements that are trivial are copied in one go, others are written one by one with the plan of the element type.
+
+Plan_op_kind :: enum u8 {
+	copy,				//size bytes at offset
+	custom,				//a serializen_table hook
+	string,
+	dynamic_array,
+	slice,
+	array,				//A fixed array of non trivial elements
+	union_value,
+	map_value,
+}
+
+//The element of an array or a variant of a union, the plan is looked up on first use (so a type can contain arrays of itself).
+Plan_elem :: struct {
+	type : typeid,
+	trivial : bool,
+	size : int,
+	align : int,
+	plan : ^Serialize_plan,		//atomic, nil until used
+}
+
+Plan_op :: struct {
+	kind : Plan_op_kind,
+	offset : int,
+	size : int,					//copy : the bytes to copy, union : the tag size
+	count : int,				//array : the element count, union : the tag offset
+	type : typeid,				//custom : the type passed to the hook
+	custom : Seri_info,
+	elem : Plan_elem,			//arrays : the element, map : the key
+	value : Plan_elem,			//map : the value
+	map_info : ^runtime.Map_Info,
+	variants : []Plan_elem,		//union
+	no_nil : bool,				//union
+}
+
+Serialize_plan :: struct {
+	type : typeid,
+	err : Serialization_error,	//.ok if the type can be serialized
+	fixed_size : int,			//The bytes that are written no matter the value
+	is_fixed : bool,			//Only copies, so fixed_size is the size of every value
+	ops : []Plan_op,
+}
+
+//The hooks in serializen_table are read when the plan is made, so register them before serializing the type (or call reset_serialize_plans).
+@(private="file")
+plan_cache : map[typeid]^Serialize_plan;
+@(private="file")
+plan_cache_mutex : sync.RW_Mutex;
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+//Returns the cached plan for the type, it is made on first use.
+serialize_plan_of :: proc (t : typeid) -> ^Serialize_plan {
+
+	sync.shared_lock(&plan_cache_mutex);
+	plan, found := plan_cache[t];
+	sync.shared_unlock(&plan_cache_mutex);
+
+	if found {
+		return plan;
+	}
+
+	//The plans are never freed while running, so they do not use the context allocator (which might be a temp or tracking allocator).
+	context.allocator = runtime.heap_allocator();
+	new_plan := _make_serialize_plan(t);
+
+	sync.lock(&plan_cache_mutex);
+	defer sync.unlock(&plan_cache_mutex);
+
+	if existing, ok := plan_cache[t]; ok {
+		//Another thread made it first.
+		_delete_serialize_plan(new_plan);
+		return existing;
+	}
+	plan_cache[t] = new_plan;
+
+	return new_plan;
+}
+
+//Frees all plans (the compact ones too), they are remade when used, only call it when nothing is being serialized.
+reset_serialize_plans :: proc () {
+	context.allocator = runtime.heap_allocator();
+
+	sync.lock(&plan_cache_mutex);
+	defer sync.unlock(&plan_cache_mutex);
+
+	for _, plan in plan_cache {
+		_delete_serialize_plan(plan);
+	}
+	delete(plan_cache);
+	plan_cache = nil;
+
+	_reset_compact_plans();
+}
+
+//Appends the value to data as described by the plan, without a header, data is grown once.
+run_serialize_plan :: proc (plan : ^Serialize_plan, value : rawptr, data : ^[dynamic]u8) -> Serialization_error {
+
+	size, err := plan_serialized_size(plan, value);
+	if err != .ok {
+		return err;
+	}
+
+	pos := len(data);
+	non_zero_resize(data, pos + size);
+
+	return _write_plan(plan, value, data[:], &pos);
+}
+
+//Writes the value into buf[pos^:] as described by the plan, without a header, buf must have room for plan_serialized_size bytes.
+run_serialize_plan_into :: proc (plan : ^Serialize_plan, value : rawptr, buf : []u8, pos : ^int) -> Serialization_error {
+	return _write_plan(plan, value, buf, pos);
+}
+
+//The bytes the plan writes for the value, for plain data this is known from the plan alone.
+plan_serialized_size :: proc (plan : ^Serialize_plan, value : rawptr) -> (size : int, err : Serialization_error) {
+
+	if plan.err != .ok {
+		return 0, plan.err;
+	}
+	if plan.is_fixed {
+		return plan.fixed_size, .ok;
+	}
+
+	size = plan.fixed_size;
+
+	for &op in plan.ops {
+		src : rawptr = _offset(value, op.offset);
+
+		switch op.kind {
+			case .copy:
+				//In fixed_size
+
+			case .custom:
+				//The hook is the only way to know, it is run twice.
+				scratch := make([dynamic]u8, context.temp_allocator);
+				op.custom.serialize(any{data = src, id = op.type}, &scratch);
+				size += len(scratch);
+
+			case .string:
+				size += len((cast(^string)src)^);
+
+			case .dynamic_array:
+				arr := cast(^runtime.Raw_Dynamic_Array)src;
+				n, n_err := _size_elems(&op.elem, arr.data, arr.len);
+				if n_err != .ok {
+					return 0, n_err;
+				}
+				size += n;
+
+			case .slice:
+				sl := cast(^runtime.Raw_Slice)src;
+				n, n_err := _size_elems(&op.elem, sl.data, sl.len);
+				if n_err != .ok {
+					return 0, n_err;
+				}
+				size += n;
+
+			case .array:
+				n, n_err := _size_elems(&op.elem, src, op.count);
+				if n_err != .ok {
+					return 0, n_err;
+				}
+				size += n;
+
+			case .union_value:
+				variant, is_nil, valid := _union_variant(&op, _offset(src, op.count));
+				if !valid {
+					return 0, .invalid_data;
+				}
+				if !is_nil {
+					n, n_err := _size_elems(variant, src, 1);
+					if n_err != .ok {
+						return 0, n_err;
+					}
+					size += n;
+				}
+
+			case .map_value:
+				it : int;
+				for k, v in reflect.iterate_map(any{data = src, id = op.type}, &it) {
+					n, n_err := _size_elems(&op.elem, k.data, 1);
+					if n_err != .ok {
+						return 0, n_err;
+					}
+					size += n;
+					n, n_err = _size_elems(&op.value, v.data, 1);
+					if n_err != .ok {
+						return 0, n_err;
+					}
+					size += n;
+				}
+		}
+	}
+
+	return size, .ok;
+}
+
+//Reads the value from data[used_bytes^:] as described by the plan, dynamic arrays and custom types allocate with alloc.
+run_deserialize_plan :: proc (plan : ^Serialize_plan, data : []u8, used_bytes : ^Header_size_type, value : rawptr, alloc : mem.Allocator, loc := #caller_location) -> Serialization_error {
+	used := cast(int)used_bytes^;
+	defer used_bytes^ = cast(Header_size_type)used;
+
+	return _run_deserialize(plan, data, &used, value, alloc, false, loc);
+}
+
+//The bytes run_deserialize_plan_packed needs for what the value at data[used_bytes:] points to (the value itself not included).
+//It is read from the stream, so it is exact up to alignment. Maps and custom serializers cannot be packed.
+plan_packed_footprint :: proc (plan : ^Serialize_plan, data : []u8, used_bytes : Header_size_type) -> (footprint : int, err : Serialization_error) {
+	used := cast(int)used_bytes;
+	err = _measure(plan, data, &used, &footprint);
+	return;
+}
+
+//Like run_deserialize_plan, but all strings and arrays are placed in block (after the value), see deserialize_from_bytes_packed.
+//block must be at least plan_packed_footprint bytes, the arrays placed in it have the nil allocator.
+run_deserialize_plan_packed :: proc (plan : ^Serialize_plan, data : []u8, used_bytes : ^Header_size_type, value : rawptr, block : []u8, loc := #caller_location) -> Serialization_error {
+	arena : mem.Arena;
+	mem.arena_init(&arena, block);
+
+	used := cast(int)used_bytes^;
+	defer used_bytes^ = cast(Header_size_type)used;
+
+	return _run_deserialize(plan, data, &used, value, mem.arena_allocator(&arena), true, loc);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+@(private="file")
+_write_plan :: proc (plan : ^Serialize_plan, value : rawptr, buf : []u8, pos : ^int) -> Serialization_error {
+
+	if plan.err != .ok {
+		return plan.err;
+	}
+
+	for &op in plan.ops {
+		src : rawptr = _offset(value, op.offset);
+
+		switch op.kind {
+			case .copy:
+				_write_raw(buf, pos, src, op.size);
+
+			case .custom:
+				scratch := make([dynamic]u8, context.temp_allocator);
+				op.custom.serialize(any{data = src, id = op.type}, &scratch);
+				_write_raw(buf, pos, raw_data(scratch), len(scratch));
+
+			case .string:
+				s := (cast(^string)src)^;
+				length := cast(u32)len(s);
+				_write_raw(buf, pos, &length, size_of(u32));
+				_write_raw(buf, pos, raw_data(s), len(s));
+
+			case .dynamic_array:
+				arr := cast(^runtime.Raw_Dynamic_Array)src;
+				_write_raw(buf, pos, &arr.len, size_of(int));
+				if res := _write_elems(&op.elem, arr.data, arr.len, buf, pos); res != .ok {
+					return res;
+				}
+
+			case .slice:
+				sl := cast(^runtime.Raw_Slice)src;
+				_write_raw(buf, pos, &sl.len, size_of(int));
+				if res := _write_elems(&op.elem, sl.data, sl.len, buf, pos); res != .ok {
+					return res;
+				}
+
+			case .array:
+				if res := _write_elems(&op.elem, src, op.count, buf, pos); res != .ok {
+					return res;
+				}
+
+			case .union_value:
+				tag_ptr := _offset(src, op.count);
+				_write_raw(buf, pos, tag_ptr, op.size);
+				variant, is_nil, valid := _union_variant(&op, tag_ptr);
+				if !valid {
+					return .invalid_data;
+				}
+				if !is_nil {
+					if res := _write_elems(variant, src, 1, buf, pos); res != .ok {
+						return res;
+					}
+				}
+
+			case .map_value:
+				raw := cast(^runtime.Raw_Map)src;
+				length := cast(int)raw.len;
+				_write_raw(buf, pos, &length, size_of(int));
+
+				it : int;
+				for k, v in reflect.iterate_map(any{data = src, id = op.type}, &it) {
+					if res := _write_elems(&op.elem, k.data, 1, buf, pos); res != .ok {
+						return res;
+					}
+					if res := _write_elems(&op.value, v.data, 1, buf, pos); res != .ok {
+						return res;
+					}
+				}
+		}
+	}
+
+	return .ok;
+}
+
+@(private="file")
+_run_deserialize :: proc (plan : ^Serialize_plan, data : []u8, used : ^int, value : rawptr, alloc : mem.Allocator, packed : bool, loc := #caller_location) -> Serialization_error {
+
+	if plan.err != .ok {
+		return plan.err;
+	}
+
+	for &op in plan.ops {
+		dst : rawptr = _offset(value, op.offset);
+
+		switch op.kind {
+			case .copy:
+				if res := _read_raw(dst, data, used, op.size); res != .ok {
+					return res;
+				}
+
+			case .custom:
+				context.allocator = alloc;
+				n, s_err := op.custom.deserialize(any{data = dst, id = op.type}, data[used^:]);
+				used^ += cast(int)n;
+				if s_err {
+					return .custom_type_invalid_data;
+				}
+
+			case .string:
+				length : u32;
+				if res := _read_raw(&length, data, used, size_of(u32)); res != .ok {
+					return res;
+				}
+				if used^ + cast(int)length > len(data) {
+					return .invalid_data;
+				}
+				s := cast(^runtime.Raw_String)dst;
+				s^ = {};
+				if length != 0 {
+					bytes, a_err := mem.alloc(cast(int)length, 1, alloc, loc);
+					if a_err != nil {
+						return .allocation_error;
+					}
+					mem.copy(bytes, &data[used^], cast(int)length);
+					s^ = {cast([^]u8)bytes, cast(int)length};
+				}
+				used^ += cast(int)length;
+
+			case .dynamic_array:
+				length : int;
+				if res := _read_raw(&length, data, used, size_of(int)); res != .ok {
+					return res;
+				}
+				if length < 0 || (length > len(data) - used^ && op.elem.size != 0) {
+					return .invalid_data;
+				}
+
+				context.allocator = alloc;
+				runtime.__dynamic_array_make(dst, op.elem.size, op.elem.align, length, length, loc);
+				arr := cast(^runtime.Raw_Dynamic_Array)dst;
+				if packed {
+					arr.allocator = mem.nil_allocator(); //It lives in the block, so it cannot grow or be freed on its own.
+				}
+				if res := _deserialize_elems(&op.elem, data, used, arr.data, length, alloc, packed, loc); res != .ok {
+					return res;
+				}
+
+			case .slice:
+				length : int;
+				if res := _read_raw(&length, data, used, size_of(int)); res != .ok {
+					return res;
+				}
+				if length < 0 || (length > len(data) - used^ && op.elem.size != 0) {
+					return .invalid_data;
+				}
+
+				sl := cast(^runtime.Raw_Slice)dst;
+				sl^ = {};
+				if length != 0 {
+					elems, a_err := mem.alloc(length * op.elem.size, op.elem.align, alloc, loc);
+					if a_err != nil {
+						return .allocation_error;
+					}
+					sl^ = {elems, length};
+				}
+				if res := _deserialize_elems(&op.elem, data, used, sl.data, length, alloc, packed, loc); res != .ok {
+					return res;
+				}
+
+			case .array:
+				if res := _deserialize_elems(&op.elem, data, used, dst, op.count, alloc, packed, loc); res != .ok {
+					return res;
+				}
+
+			case .union_value:
+				tag_ptr := _offset(dst, op.count);
+				if res := _read_raw(tag_ptr, data, used, op.size); res != .ok {
+					return res;
+				}
+				variant, is_nil, valid := _union_variant(&op, tag_ptr);
+				if !valid {
+					return .invalid_data;
+				}
+				if !is_nil {
+					if res := _deserialize_elems(variant, data, used, dst, 1, alloc, packed, loc); res != .ok {
+						return res;
+					}
+				}
+
+			case .map_value:
+				length : int;
+				if res := _read_raw(&length, data, used, size_of(int)); res != .ok {
+					return res;
+				}
+				if length < 0 || length > len(data) - used^ {
+					return .invalid_data;
+				}
+
+				raw := cast(^runtime.Raw_Map)dst;
+				raw^ = {};
+				raw.allocator = alloc;
+				if length == 0 {
+					continue;
+				}
+				if runtime.map_reserve_dynamic(raw, op.map_info, cast(uintptr)length, loc) != nil {
+					return .allocation_error;
+				}
+
+				//Every entry is read into the scratch and then copied into the map.
+				value_offset := mem.align_forward_int(op.elem.size, op.value.align);
+				scratch, a_err := mem.alloc(value_offset + op.value.size, max(op.elem.align, op.value.align), alloc, loc);
+				if a_err != nil {
+					return .allocation_error;
+				}
+				defer mem.free(scratch, alloc);
+
+				for _ in 0..<length {
+					mem.zero(scratch, value_offset + op.value.size);
+					if res := _deserialize_elems(&op.elem, data, used, scratch, 1, alloc, packed, loc); res != .ok {
+						return res;
+					}
+					if res := _deserialize_elems(&op.value, data, used, _offset(scratch, value_offset), 1, alloc, packed, loc); res != .ok {
+						return res;
+					}
+					runtime.__dynamic_map_set_without_hash(raw, op.map_info, scratch, _offset(scratch, value_offset), loc);
+				}
+		}
+	}
+
+	return .ok;
+}
+
+//Walks the stream like _run_deserialize, but only adds up the allocations it would make (in the same order and alignment).
+@(private="file")
+_measure :: proc (plan : ^Serialize_plan, data : []u8, used : ^int, footprint : ^int) -> Serialization_error {
+
+	if plan.err != .ok {
+		return plan.err;
+	}
+
+	for &op in plan.ops {
+		switch op.kind {
+			case .copy:
+				if used^ + op.size > len(data) {
+					return .invalid_data;
+				}
+				used^ += op.size;
+
+			case .custom, .map_value:
+				return .type_not_supported;
+
+			case .string:
+				length : u32;
+				if res := _read_raw(&length, data, used, size_of(u32)); res != .ok {
+					return res;
+				}
+				if used^ + cast(int)length > len(data) {
+					return .invalid_data;
+				}
+				_measure_alloc(footprint, cast(int)length, 1);
+				used^ += cast(int)length;
+
+			case .dynamic_array, .slice:
+				length : int;
+				if res := _read_raw(&length, data, used, size_of(int)); res != .ok {
+					return res;
+				}
+				if length < 0 || (length > len(data) - used^ && op.elem.size != 0) {
+					return .invalid_data;
+				}
+				_measure_alloc(footprint, length * op.elem.size, op.elem.align);
+				if res := _measure_elems(&op.elem, data, used, length, footprint); res != .ok {
+					return res;
+				}
+
+			case .array:
+				if res := _measure_elems(&op.elem, data, used, op.count, footprint); res != .ok {
+					return res;
+				}
+
+			case .union_value:
+				tag : u64;
+				if res := _read_raw(&tag, data, used, op.size); res != .ok {
+					return res;
+				}
+				variant, is_nil, valid := _union_variant(&op, &tag); //little endian, the low bytes are the tag
+				if !valid {
+					return .invalid_data;
+				}
+				if !is_nil {
+					if res := _measure_elems(variant, data, used, 1, footprint); res != .ok {
+						return res;
+					}
+				}
+		}
+	}
+
+	return .ok;
+}
+
+@(private="file")
+_measure_elems :: proc (elem : ^Plan_elem, data : []u8, used : ^int, count : int, footprint : ^int) -> Serialization_error {
+	if elem.trivial {
+		if used^ + count * elem.size > len(data) {
+			return .invalid_data;
+		}
+		used^ += count * elem.size;
+		return .ok;
+	}
+
+	plan := _elem_plan(elem);
+	for _ in 0..<count {
+		res := _measure(plan, data, used, footprint);
+		if res != .ok {
+			return res;
+		}
+	}
+	return .ok;
+}
+
+//What a mem.Arena uses for the allocation, the block is DEFAULT_ALIGNMENT aligned so bigger alignments need slack.
+@(private="file")
+_measure_alloc :: #force_inline proc (footprint : ^int, size : int, align : int) {
+	if align > runtime.DEFAULT_ALIGNMENT {
+		footprint^ += align - 1;
+	}
+	footprint^ = mem.align_forward_int(footprint^, max(align, 1)) + size;
+}
+
+@(private)
+_offset :: #force_inline proc (ptr : rawptr, offset : int) -> rawptr {
+	return cast(rawptr)(cast(uintptr)ptr + cast(uintptr)offset);
+}
+
+//The size was computed up front, so this only bounds checks.
+@(private="file")
+_write_raw :: #force_inline proc (buf : []u8, pos : ^int, src : rawptr, size : int) {
+	if size == 0 {
+		return;
+	}
+	dst := buf[pos^:pos^ + size];
+	mem.copy(raw_data(dst), src, size);
+	pos^ += size;
+}
+
+@(private)
+_read_raw :: #force_inline proc (dst : rawptr, data : []u8, used : ^int, size : int) -> Serialization_error {
+	if size == 0 {
+		return .ok;
+	}
+	if used^ + size > len(data) {
+		return .invalid_data;
+	}
+	mem.copy(dst, &data[used^], size);
+	used^ += size;
+	return .ok;
+}
+
+@(private="file")
+_elem_plan :: #force_inline proc (elem : ^Plan_elem) -> ^Serialize_plan {
+	plan := intrinsics.atomic_load(&elem.plan);
+	if plan == nil {
+		plan = serialize_plan_of(elem.type);
+		intrinsics.atomic_store(&elem.plan, plan);
+	}
+	return plan;
+}
+
+@(private="file")
+_size_elems :: proc (elem : ^Plan_elem, src : rawptr, count : int) -> (size : int, err : Serialization_error) {
+	if elem.trivial {
+		return count * elem.size, .ok;
+	}
+
+	plan := _elem_plan(elem);
+	if plan.is_fixed {
+		return count * plan.fixed_size, .ok;
+	}
+	for i in 0..<count {
+		n, n_err := plan_serialized_size(plan, _offset(src, i * elem.size));
+		if n_err != .ok {
+			return 0, n_err;
+		}
+		size += n;
+	}
+	return size, .ok;
+}
+
+@(private="file")
+_write_elems :: proc (elem : ^Plan_elem, src : rawptr, count : int, buf : []u8, pos : ^int) -> Serialization_error {
+	if elem.trivial {
+		_write_raw(buf, pos, src, count * elem.size);
+		return .ok;
+	}
+
+	plan := _elem_plan(elem);
+	for i in 0..<count {
+		res := _write_plan(plan, _offset(src, i * elem.size), buf, pos);
+		if res != .ok {
+			return res;
+		}
+	}
+	return .ok;
+}
+
+@(private="file")
+_deserialize_elems :: proc (elem : ^Plan_elem, data : []u8, used : ^int, dst : rawptr, count : int, alloc : mem.Allocator, packed : bool, loc := #caller_location) -> Serialization_error {
+	if elem.trivial {
+		return _read_raw(dst, data, used, count * elem.size);
+	}
+
+	plan := _elem_plan(elem);
+	for i in 0..<count {
+		res := _run_deserialize(plan, data, used, _offset(dst, i * elem.size), alloc, packed, loc);
+		if res != .ok {
+			return res;
+		}
+	}
+	return .ok;
+}
+
+//The variant the tag at tag_ptr selects.
+@(private="file")
+_union_variant :: proc (op : ^Plan_op, tag_ptr : rawptr) -> (variant : ^Plan_elem, is_nil : bool, valid : bool) {
+	tag : int;
+	switch op.size {
+		case 1: tag = cast(int)(cast(^u8)tag_ptr)^;
+		case 2: tag = cast(int)(cast(^u16)tag_ptr)^;
+		case 4: tag = cast(int)(cast(^u32)tag_ptr)^;
+		case 8: tag = cast(int)(cast(^u64)tag_ptr)^;
+		case: return nil, false, false;
+	}
+
+	if !op.no_nil {
+		if tag == 0 {
+			return nil, true, true;
+		}
+		tag -= 1;
+	}
+	if tag < 0 || tag >= len(op.variants) {
+		return nil, false, false;
+	}
+
+	return &op.variants[tag], false, true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+@(private="file")
+_make_serialize_plan :: proc (t : typeid) -> ^Serialize_plan {
+
+	ops := make([dynamic]Plan_op);
+	plan := new(Serialize_plan);
+	plan.type = t;
+	plan.err = _plan_append(&ops, type_info_of(t), 0);
+
+	for op in ops {
+		switch op.kind {
+			case .copy:
+				plan.fixed_size += op.size;
+			case .string:
+				plan.fixed_size += size_of(u32);
+			case .dynamic_array, .slice, .map_value:
+				plan.fixed_size += size_of(int);
+			case .union_value:
+				plan.fixed_size += op.size;
+			case .custom, .array:
+		}
+	}
+
+	plan.is_fixed = plan.err == .ok;
+	for op in ops {
+		if op.kind != .copy {
+			plan.is_fixed = false;
+		}
+	}
+
+	shrink(&ops);
+	plan.ops = ops[:];
+
+	return plan;
+}
+
+@(private="file")
+_delete_serialize_plan :: proc (plan : ^Serialize_plan) {
+	for op in plan.ops {
+		delete(op.variants);
+	}
+	delete(plan.ops);
+	free(plan);
+}
+
+@(private="file")
+_plan_elem :: proc (ti : ^runtime.Type_Info) -> Plan_elem {
+	return {type = ti.id, trivial = is_trivial_copied(ti.id), size = ti.size, align = ti.align};
+}
+
+//Appends the ops for a value of the type at offset.
+@(private="file")
+_plan_append :: proc (ops : ^[dynamic]Plan_op, ti : ^runtime.Type_Info, offset : int) -> Serialization_error {
+	using runtime;
+
+	//Strings have their own op, it writes the same as string_seri.
+	if hook, ok := serializen_table[ti.id]; ok && ti.id != string {
+		append(ops, Plan_op{kind = .custom, offset = offset, type = ti.id, custom = hook});
+		return .ok;
+	}
+
+	if is_trivial_copied(ti.id) {
+		_plan_append_copy(ops, offset, ti.size);
+		return .ok;
+	}
+
+	base := type_info_base(ti);
+
+	#partial switch info in base.variant {
+		case Type_Info_Struct:
+			for i in 0..<info.field_count {
+				res := _plan_append(ops, info.types[i], offset + cast(int)info.offsets[i]);
+				if res != .ok {
+					return res;
+				}
+			}
+
+		case Type_Info_String:
+			if info.is_cstring {
+				return .type_not_supported;
+			}
+			append(ops, Plan_op{kind = .string, offset = offset});
+
+		case Type_Info_Dynamic_Array:
+			append(ops, Plan_op{kind = .dynamic_array, offset = offset, elem = _plan_elem(info.elem)});
+
+		case Type_Info_Slice:
+			append(ops, Plan_op{kind = .slice, offset = offset, elem = _plan_elem(info.elem)});
+
+		case Type_Info_Array:
+			append(ops, Plan_op{kind = .array, offset = offset, count = info.count, elem = _plan_elem(info.elem)});
+
+		case Type_Info_Enumerated_Array:
+			append(ops, Plan_op{kind = .array, offset = offset, count = info.count, elem = _plan_elem(info.elem)});
+
+		case Type_Info_Union:
+			if info.tag_type == nil || len(info.variants) == 0 {
+				return .type_not_supported;
+			}
+			variants := make([]Plan_elem, len(info.variants));
+			for v, i in info.variants {
+				variants[i] = _plan_elem(v);
+			}
+			append(ops, Plan_op{kind = .union_value, offset = offset, size = info.tag_type.size, count = cast(int)info.tag_offset, variants = variants, no_nil = info.no_nil});
+
+		case Type_Info_Map:
+			append(ops, Plan_op{kind = .map_value, offset = offset, type = ti.id, elem = _plan_elem(info.key), value = _plan_elem(info.value), map_info = info.map_info});
+
+		case:
+			return .type_not_supported;
+	}
+
+	return .ok;
+}
+
+//Merges with the previous op if it is a copy that ends where this one begins.
+@(private="file")
+_plan_append_copy :: proc (ops : ^[dynamic]Plan_op, offset : int, size : int) {
+	if size == 0 {
+		return;
+	}
+	if len(ops) != 0 {
+		last := &ops[len(ops) - 1];
+		if last.kind == .copy && last.offset + last.size == offset {
+			last.size += size;
+			return;
+		}
+	}
+	append(ops, Plan_op{kind = .copy, offset = offset, size = size});
+}
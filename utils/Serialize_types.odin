@@ -11,9 +11,7 @@ string_seri : Serialize_proc : proc(value : any, append_to : ^[dynamic]u8) {
 	header : u32 = cast(u32)len(s);
 	append_type_to_data(header, append_to);
 
-	for i in 0..<len(s) { //TODO this is slow
-		append(append_to, s[i]);
-	}
+	append(append_to, s);
 
 }
 
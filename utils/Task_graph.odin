@@ -0,0 +1,310 @@
+package utils;
+
+import "core:fmt"
+import "core:strings"
+import "core:time"
+import "base:intrinsics"
+import base_thread "core:thread"
+
+import "../tracy"
+
+//A graph of tasks with dependencies, built once and run every frame on the job system (see Jobs.odin).
+//A task starts when all the tasks it depends on are done, so independent work (layout, culling, mesh generation, animation) overlaps across the workers.
+//Tasks marked on_owner only run on the thread that calls task_graph_run, that is where GL calls (uploads, draws, swapping) must go.
+//After every run the start and end of each task is kept, task_graph_critical_path and task_graph_print_timings show what the frame waited on.
+//The tasks run with the context of the thread running them, and the graph must not be moved after a task is added.
+//
+//	graph : utils.Task_graph;
+//	input := utils.task_graph_add(&graph, "input", input_task, nil, on_owner = true);
+//	update := utils.task_graph_add(&graph, "update", update_task, &game, false, input);
+//	layout := utils.task_graph_add(&graph, "layout", layout_task, &ui, false, input);
+//	utils.task_graph_add(&graph, "draw", draw_task, &game, true, update, layout);
+//	for !should_close {
+//		utils.task_graph_run(&graph);
+//	}
+//	utils.task_graph_destroy(&graph);
+
+Task_proc :: #type proc (data : rawptr);
+
+Task_id :: distinct int;
+
+Task_node :: struct {
+	name : string,				//Not copied
+	procedure : Task_proc,
+	data : rawptr,
+	on_owner : bool,
+
+	dependencies : [dynamic]Task_id,
+	dependents : [dynamic]Task_id,		//Found in task_graph_build
+
+	graph : ^Task_graph,
+	id : Task_id,
+	pending : int,				//atomic, the dependencies that are not done this run
+
+	//The last run, relative to the start of the run.
+	start, end : time.Duration,
+	ran_on_owner : bool,
+}
+
+Task_graph :: struct {
+	nodes : [dynamic]^Task_node,
+	order : []Task_id,			//Topological, found in task_graph_build
+	roots : [dynamic]Task_id,
+	built : bool,
+
+	owner_ready : Mpmc_queue(Task_id),
+	remaining : int,			//atomic, the nodes that are not done this run
+
+	run_start : time.Tick,
+	run_time : time.Duration,	//The last run
+	runs : int,
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+//Adds a task that depends on the given tasks, it can not be added after the graph is built.
+task_graph_add :: proc (graph : ^Task_graph, name : string, procedure : Task_proc, data : rawptr = nil, on_owner := false, dependencies : ..Task_id, loc := #caller_location) -> Task_id {
+	fmt.assertf(!graph.built, "Task %v is added after the graph is built", name, loc = loc);
+
+	node := new(Task_node);
+	node^ = {
+		name = name,
+		procedure = procedure,
+		data = data,
+		on_owner = on_owner,
+		graph = graph,
+		id = cast(Task_id)len(graph.nodes),
+	};
+	append(&graph.nodes, node);
+
+	for d in dependencies {
+		task_graph_depend(graph, node.id, d, loc);
+	}
+
+	return node.id;
+}
+
+//Makes task wait on dependency.
+task_graph_depend :: proc (graph : ^Task_graph, task : Task_id, dependency : Task_id, loc := #caller_location) {
+	fmt.assertf(!graph.built, "Dependency added after the graph is built", loc = loc);
+	fmt.assertf(cast(int)task < len(graph.nodes) && cast(int)dependency < len(graph.nodes), "Invalid task id %v or %v", task, dependency, loc = loc);
+	fmt.assertf(task != dependency, "Task %v depends on itself", graph.nodes[task].name, loc = loc);
+
+	append(&graph.nodes[task].dependencies, dependency);
+}
+
+//Finds the order and checks for cycles, it is called by the first task_graph_run if not called before.
+task_graph_build :: proc (graph : ^Task_graph, loc := #caller_location) {
+	if graph.built {
+		return;
+	}
+
+	for n in graph.nodes {
+		clear(&n.dependents);
+	}
+	for n in graph.nodes {
+		for d in n.dependencies {
+			append(&graph.nodes[d].dependents, n.id);
+		}
+	}
+
+	//Kahn's algorithm, what is left is a cycle.
+	pending := make([]int, len(graph.nodes), context.temp_allocator);
+	order := make([dynamic]Task_id, 0, len(graph.nodes));
+	clear(&graph.roots);
+	for n in graph.nodes {
+		pending[n.id] = len(n.dependencies);
+		if pending[n.id] == 0 {
+			append(&order, n.id);
+			append(&graph.roots, n.id);
+		}
+	}
+	for i := 0; i < len(order); i += 1 {
+		for d in graph.nodes[order[i]].dependents {
+			pending[d] -= 1;
+			if pending[d] == 0 {
+				append(&order, d);
+			}
+		}
+	}
+
+	if len(order) != len(graph.nodes) {
+		cycle := make([dynamic]string, context.temp_allocator);
+		for n in graph.nodes {
+			if pending[n.id] != 0 {
+				append(&cycle, n.name);
+			}
+		}
+		fmt.panicf("The task graph has a cycle, between %v", cycle[:], loc = loc);
+	}
+
+	graph.order = order[:];
+	capacity := 2;
+	for capacity < len(graph.nodes) {
+		capacity *= 2;
+	}
+	mpmc_init(&graph.owner_ready, capacity);
+	graph.built = true;
+}
+
+task_graph_destroy :: proc (graph : ^Task_graph) {
+	for n in graph.nodes {
+		delete(n.dependencies);
+		delete(n.dependents);
+		free(n);
+	}
+	delete(graph.nodes);
+	delete(graph.order);
+	delete(graph.roots);
+	if graph.built {
+		mpmc_destroy(&graph.owner_ready);
+	}
+	graph^ = {};
+}
+
+//Runs every task once and returns when all are done. The calling thread runs the on_owner tasks and helps with the rest.
+task_graph_run :: proc (graph : ^Task_graph, loc := #caller_location) {
+	tracy.Zone();
+
+	task_graph_build(graph, loc);
+	if len(graph.nodes) == 0 {
+		return;
+	}
+
+	for n in graph.nodes {
+		intrinsics.atomic_store(&n.pending, len(n.dependencies));
+	}
+	intrinsics.atomic_store(&graph.remaining, len(graph.nodes));
+	graph.run_start = time.tick_now();
+
+	for r in graph.roots {
+		_task_ready(graph.nodes[r]);
+	}
+
+	spins := 0;
+	for intrinsics.atomic_load(&graph.remaining) > 0 {
+		if id, ok := mpmc_pop(&graph.owner_ready); ok {
+			_task_execute(graph.nodes[id], true);
+			spins = 0;
+		}
+		else if job_help() {
+			spins = 0;
+		}
+		else {
+			spins += 1;
+			if spins > 64 {
+				base_thread.yield();
+			}
+			else {
+				intrinsics.cpu_relax();
+			}
+		}
+	}
+
+	graph.run_time = time.tick_since(graph.run_start);
+	graph.runs += 1;
+}
+
+//The chain of dependencies that took the longest in the last run, the frame can not be shorter then its length.
+//Shortening a task that is not on it does not make the frame faster.
+task_graph_critical_path :: proc (graph : ^Task_graph, alloc := context.temp_allocator) -> (path : []Task_id, length : time.Duration) {
+	if graph.runs == 0 || len(graph.nodes) == 0 {
+		return;
+	}
+
+	finish := make([]time.Duration, len(graph.nodes), context.temp_allocator);
+	prev := make([]Task_id, len(graph.nodes), context.temp_allocator);
+
+	last : Task_id;
+	for id in graph.order {
+		n := graph.nodes[id];
+		longest : time.Duration;
+		prev[id] = -1;
+		for d in n.dependencies {
+			if finish[d] > longest || prev[id] == -1 {
+				longest = finish[d];
+				prev[id] = d;
+			}
+		}
+		finish[id] = longest + (n.end - n.start);
+		if finish[id] > finish[last] {
+			last = id;
+		}
+	}
+
+	count := 0;
+	for id := last; id != -1; id = prev[id] {
+		count += 1;
+	}
+	path = make([]Task_id, count, alloc);
+	for id := last; id != -1; id = prev[id] {
+		count -= 1;
+		path[count] = id;
+	}
+
+	return path, finish[last];
+}
+
+//Prints when each task ran in the last run, the tasks on the critical path are marked with a *.
+task_graph_print_timings :: proc (graph : ^Task_graph) {
+	path, length := task_graph_critical_path(graph);
+	on_path := make([]bool, len(graph.nodes), context.temp_allocator);
+	names := make([]string, len(path), context.temp_allocator);
+	for id, i in path {
+		on_path[id] = true;
+		names[i] = graph.nodes[id].name;
+	}
+
+	fmt.printf("frame %.3f ms, critical path %.3f ms : %v\n", _ms(graph.run_time), _ms(length), strings.join(names, " -> ", context.temp_allocator));
+	fmt.printf("  %-24s %10s %10s %10s\n", "task", "start ms", "time ms", "thread");
+	for id in graph.order {
+		n := graph.nodes[id];
+		fmt.printf("%v %-24s %10.3f %10.3f %10s\n", on_path[id] ? "*" : " ", n.name, _ms(n.start), _ms(n.end - n.start), n.ran_on_owner ? "owner" : "worker");
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+@(private="file")
+_ms :: proc (d : time.Duration) -> f64 {
+	return time.duration_milliseconds(d);
+}
+
+@(private="file")
+_task_ready :: proc (node : ^Task_node) {
+	if node.on_owner {
+		//It has room for every node, so it can not fail.
+		mpmc_push(&node.graph.owner_ready, node.id);
+	}
+	else {
+		job_spawn(_task_job, node);
+	}
+}
+
+@(private="file")
+_task_job :: proc (data : rawptr) {
+	_task_execute(cast(^Task_node)data, false);
+}
+
+@(private="file")
+_task_execute :: proc (node : ^Task_node, on_owner : bool) {
+	graph := node.graph;
+
+	{
+		tracy.ZoneN(node.name);
+		node.start = time.tick_diff(graph.run_start, time.tick_now());
+		if node.procedure != nil {
+			node.procedure(node.data);
+		}
+		node.end = time.tick_diff(graph.run_start, time.tick_now());
+		node.ran_on_owner = on_owner;
+	}
+
+	for d in node.dependents {
+		dependent := graph.nodes[d];
+		if intrinsics.atomic_sub(&dependent.pending, 1) == 1 {
+			_task_ready(dependent);
+		}
+	}
+	intrinsics.atomic_sub(&graph.remaining, 1);
+}
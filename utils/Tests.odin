@@ -3,6 +3,11 @@ package utils;
 import "core:fmt"
 import "base:runtime"
 import "core:testing"
+import "core:time"
+import "core:strings"
+import "base:intrinsics"
+import "core:slice"
+import "core:sync"
 
 @test
 test_seri_deseri_dyn_arr :: proc (t : ^testing.T) {
@@ -27,4 +32,602 @@ test_seri_deseri_dyn_arr :: proc (t : ^testing.T) {
 	}
 
 	free_all(context.temp_allocator);
-}
\ No newline at end of file
+}
+
+@test
+test_mpmc_queue :: proc (t : ^testing.T) {
+
+	Producer_count :: 4;
+	Per_producer :: 100_000;
+
+	q : Mpmc_queue(int);
+	mpmc_init(&q, 1024);
+	defer mpmc_destroy(&q);
+
+	testing.expect(t, mpmc_push(&q, 1));
+	v, ok := mpmc_pop(&q);
+	testing.expect(t, ok && v == 1);
+	_, ok = mpmc_pop(&q);
+	testing.expect(t, !ok, "the queue should be empty");
+
+	producers : [Producer_count]^Thread;
+	for &p, i in producers {
+		p = create(proc (t : ^Thread) {
+			q := cast(^Mpmc_queue(int))t.data;
+			for i in 1..=Per_producer {
+				mpmc_push_wait(q, i);
+			}
+		}, &q, i);
+		start(p);
+	}
+
+	popped := 0;
+	sum := 0;
+	for popped < Producer_count * Per_producer {
+		if v, ok := mpmc_pop(&q); ok {
+			popped += 1;
+			sum += v;
+		}
+	}
+
+	for p in producers {
+		destroy(p);
+		free(p);
+	}
+
+	testing.expect_value(t, sum, Producer_count * (Per_producer * (Per_producer + 1) / 2));
+	testing.expect_value(t, mpmc_len(&q), 0);
+}
+
+@test
+bench_serialize_plan :: proc (t : ^testing.T) {
+
+	Bench_inner :: struct {
+		a : [4]f32,
+		b : i32,
+		name : string,
+	}
+
+	Bench_message :: struct {
+		id : u64,
+		flags : u16,
+		position : [3]f32,
+		inner : Bench_inner,
+		values : [dynamic]i32,
+		tag : string,
+	}
+
+	Iterations :: 100_000;
+
+	msg := Bench_message{id = 7, flags = 3, position = {1, 2, 3}, inner = {a = {4, 5, 6, 7}, b = -8, name = "inner name"}, tag = "a tag"};
+	msg.values = make([dynamic]i32, 0, 32, context.temp_allocator);
+	for i in 0..<32 {
+		append(&msg.values, cast(i32)i);
+	}
+
+	//Both paths must produce the same bytes.
+	planned := make([dynamic]u8, context.temp_allocator);
+	reflected := make([dynamic]u8, context.temp_allocator);
+	testing.expect_value(t, serialize_to_bytes(msg, &planned), Serialization_error.ok);
+	testing.expect_value(t, serialize_to_bytes_reflected(msg, &reflected), Serialization_error.ok);
+	testing.expect(t, string(planned[:]) == string(reflected[:]), "the planned and reflected bytes differ");
+
+	val, err := deserialize_from_bytes(Bench_message, planned[:], context.temp_allocator);
+	testing.expect_value(t, err, Serialization_error.ok);
+	if err == .ok {
+		back := val.(Bench_message);
+		testing.expect_value(t, back.id, msg.id);
+		testing.expect_value(t, back.inner.name, msg.inner.name);
+		testing.expect_value(t, back.tag, msg.tag);
+		testing.expect_value(t, len(back.values), len(msg.values));
+	}
+
+	buf := make([dynamic]u8, 0, 1024);
+	defer delete(buf);
+
+	sw : time.Stopwatch;
+	bench :: proc (sw : ^time.Stopwatch, msg : ^Bench_message, buf : ^[dynamic]u8, use_plan : bool, deserialize : bool) -> f64 {
+		time.stopwatch_reset(sw);
+		time.stopwatch_start(sw);
+		for _ in 0..<Iterations {
+			clear(buf);
+			if use_plan {
+				serialize_to_bytes(msg^, buf);
+			}
+			else {
+				serialize_to_bytes_reflected(msg^, buf);
+			}
+			if deserialize {
+				if use_plan {
+					deserialize_from_bytes(Bench_message, buf[:], context.temp_allocator);
+				}
+				else {
+					deserialize_from_bytes_reflected(Bench_message, buf[:], context.temp_allocator);
+				}
+				free_all(context.temp_allocator);
+			}
+		}
+		time.stopwatch_stop(sw);
+		return cast(f64)time.stopwatch_duration(sw^) / Iterations;
+	}
+
+	msg_copy := msg;
+	msg_copy.values = make([dynamic]i32, len(msg.values));
+	copy(msg_copy.values[:], msg.values[:]);
+	defer delete(msg_copy.values);
+	free_all(context.temp_allocator);
+
+	ser_reflected := bench(&sw, &msg_copy, &buf, false, false);
+	ser_planned := bench(&sw, &msg_copy, &buf, true, false);
+	round_reflected := bench(&sw, &msg_copy, &buf, false, true);
+	round_planned := bench(&sw, &msg_copy, &buf, true, true);
+
+	fmt.printf("serialize   : reflected %.0f ns/op, planned %.0f ns/op (%.1fx)\n", ser_reflected, ser_planned, ser_reflected / ser_planned);
+	fmt.printf("round trip  : reflected %.0f ns/op, planned %.0f ns/op (%.1fx)\n", round_reflected, round_planned, round_reflected / round_planned);
+}
+
+@test
+test_is_trivial_copied :: proc (t : ^testing.T) {
+
+	Flag :: enum u8 {a, b, c};
+	Packed_bits :: bit_field u16 {
+		x : u8 | 4,
+		y : u8 | 4,
+		z : u8 | 8,
+	};
+	Trivial_struct :: struct {
+		flags : bit_set[Flag],
+		bits : Packed_bits,
+		lanes : #simd[4]f32,
+	};
+	Non_trivial_struct :: struct {
+		inner : Trivial_struct,
+		name : string,
+	};
+
+	testing.expect(t, is_trivial_copied(bit_set[Flag]));
+	testing.expect(t, is_trivial_copied(Packed_bits));
+	testing.expect(t, is_trivial_copied(#simd[4]f32));
+	testing.expect(t, is_trivial_copied(Trivial_struct));
+	testing.expect(t, !is_trivial_copied(Non_trivial_struct));
+
+	//The second answer comes from the cache and must be the same.
+	testing.expect(t, is_trivial_copied(Trivial_struct));
+	testing.expect(t, !is_trivial_copied(Non_trivial_struct));
+
+	//A trivial struct is now a single copy.
+	plan := serialize_plan_of(Trivial_struct);
+	testing.expect_value(t, len(plan.ops), 1);
+}
+
+@test
+test_serialize_all_types :: proc (t : ^testing.T) {
+
+	Shape :: union {
+		[2]f32,
+		string,
+	};
+
+	Item :: struct {
+		name : string,
+		tags : [dynamic]string,
+	};
+
+	Save :: struct {
+		shapes : [3]Shape,
+		items : [dynamic]Item,
+		grid : [dynamic][dynamic]u8,
+		weights : []f32,
+		names : [2]string,
+		lookup : map[string]int,
+	};
+
+	save : Save;
+	save.shapes = {[2]f32{1, 2}, "circle", nil};
+	save.items = make([dynamic]Item, context.temp_allocator);
+	append(&save.items, Item{name = "sword"}, Item{name = "shield"});
+	save.items[0].tags = make([dynamic]string, context.temp_allocator);
+	append(&save.items[0].tags, "sharp", "heavy");
+	save.grid = make([dynamic][dynamic]u8, context.temp_allocator);
+	for i in 0..<3 {
+		row := make([dynamic]u8, context.temp_allocator);
+		for j in 0..<i {
+			append(&row, cast(u8)(i * 10 + j));
+		}
+		append(&save.grid, row);
+	}
+	save.weights = []f32{0.5, 0.25};
+	save.names = {"first", "second"};
+	save.lookup = make(map[string]int, context.temp_allocator);
+	save.lookup["a"] = 1;
+	save.lookup["bb"] = 22;
+
+	ser := make([dynamic]u8, context.temp_allocator);
+	testing.expect_value(t, serialize_to_bytes(save, &ser), Serialization_error.ok);
+
+	val, err := deserialize_from_bytes(Save, ser[:], context.temp_allocator);
+	testing.expect_value(t, err, Serialization_error.ok);
+	if err != .ok {
+		return;
+	}
+	back := val.(Save);
+
+	testing.expect_value(t, back.shapes[0].([2]f32), [2]f32{1, 2});
+	testing.expect_value(t, back.shapes[1].(string), "circle");
+	testing.expect(t, back.shapes[2] == nil);
+	testing.expect_value(t, len(back.items), 2);
+	testing.expect_value(t, back.items[1].name, "shield");
+	testing.expect_value(t, len(back.items[0].tags), 2);
+	testing.expect_value(t, back.items[0].tags[1], "heavy");
+	testing.expect_value(t, len(back.grid), 3);
+	testing.expect_value(t, len(back.grid[2]), 2);
+	testing.expect_value(t, back.grid[2][1], 21);
+	testing.expect_value(t, len(back.weights), 2);
+	testing.expect_value(t, back.weights[1], 0.25);
+	testing.expect_value(t, back.names[1], "second");
+	testing.expect_value(t, len(back.lookup), 2);
+	testing.expect_value(t, back.lookup["bb"], 22);
+
+	//Truncated data is an error, not a crash.
+	_, err = deserialize_from_bytes(Save, ser[:len(ser) - 3], context.temp_allocator);
+	testing.expect_value(t, err, Serialization_error.invalid_data);
+
+	free_all(context.temp_allocator);
+}
+
+@test
+test_serialize_into :: proc (t : ^testing.T) {
+
+	Message :: struct {
+		id : u32,
+		name : string,
+		values : [dynamic]f32,
+	};
+
+	msg := Message{id = 3, name = "hello"};
+	msg.values = make([dynamic]f32, context.temp_allocator);
+	append(&msg.values, 1, 2, 3);
+
+	appended := make([dynamic]u8, context.temp_allocator);
+	testing.expect_value(t, serialize_to_bytes(msg, &appended), Serialization_error.ok);
+
+	size, err := serialized_size(msg);
+	testing.expect_value(t, err, Serialization_error.ok);
+	testing.expect_value(t, size, len(appended));
+
+	//Exactly the same bytes, into a fixed buffer.
+	buf : [256]u8;
+	written : int;
+	written, err = serialize_into(msg, buf[:]);
+	testing.expect_value(t, err, Serialization_error.ok);
+	testing.expect_value(t, written, size);
+	testing.expect(t, string(buf[:written]) == string(appended[:]));
+
+	_, err = serialize_into(msg, buf[:size - 1]);
+	testing.expect_value(t, err, Serialization_error.buffer_too_small);
+
+	//And to a writer.
+	b := strings.builder_make(context.temp_allocator);
+	written, err = serialize_to_writer(msg, strings.to_writer(&b));
+	testing.expect_value(t, err, Serialization_error.ok);
+	testing.expect_value(t, written, size);
+	testing.expect(t, strings.to_string(b) == string(appended[:]));
+
+	free_all(context.temp_allocator);
+}
+
+@test
+test_deserialize_packed :: proc (t : ^testing.T) {
+
+	Node :: struct {
+		name : string,
+		weights : []f64,
+		children : [dynamic]Node,
+	};
+
+	Scene :: struct {
+		id : u32,
+		root : Node,
+		labels : [3]string,
+	};
+
+	scene := Scene{id = 9, labels = {"a", "bb", "ccc"}};
+	scene.root.name = "root";
+	scene.root.children = make([dynamic]Node, context.temp_allocator);
+	for i in 0..<4 {
+		child := Node{name = "child", weights = make([]f64, i + 1, context.temp_allocator)};
+		for &w, j in child.weights {
+			w = cast(f64)(i * 10 + j);
+		}
+		append(&scene.root.children, child);
+	}
+
+	ser := make([dynamic]u8, context.temp_allocator);
+	testing.expect_value(t, serialize_to_bytes(scene, &ser), Serialization_error.ok);
+
+	//The tracking allocator of the test runner catches it if anything but the block is allocated.
+	val, err := deserialize_from_bytes_packed(Scene, ser[:], context.allocator);
+	testing.expect_value(t, err, Serialization_error.ok);
+	defer free(val.data);
+
+	if err == .ok {
+		back := val.(Scene);
+		testing.expect_value(t, back.id, 9);
+		testing.expect_value(t, back.root.name, "root");
+		testing.expect_value(t, len(back.root.children), 4);
+		testing.expect_value(t, back.root.children[3].weights[2], 32);
+		testing.expect_value(t, back.labels[2], "ccc");
+	}
+
+	free_all(context.temp_allocator);
+}
+
+@test
+test_serialize_compact :: proc (t : ^testing.T) {
+
+	Kind :: enum i32 {idle, walking = 5, running = 300};
+
+	Player_update :: struct {
+		id : u64,
+		health : i32,
+		delta : i16,
+		kind : Kind,
+		position : [3]f32 `quant:"0.01"`,
+		angle : f32,
+		name : string,
+		hits : [dynamic]u32,
+	};
+
+	update := Player_update{id = 42, health = 100, delta = -3, kind = .running, position = {12.34, -5.67, 0.5}, angle = 1.25, name = "bob"};
+	update.hits = make([dynamic]u32, context.temp_allocator);
+	append(&update.hits, 1, 200, 70_000);
+
+	native := make([dynamic]u8, context.temp_allocator);
+	compact := make([dynamic]u8, context.temp_allocator);
+	testing.expect_value(t, serialize_to_bytes(update, &native), Serialization_error.ok);
+	testing.expect_value(t, serialize_to_bytes_compact(update, &compact), Serialization_error.ok);
+
+	size, _ := compact_serialized_size(update);
+	testing.expect_value(t, size, len(compact));
+	fmt.printf("Player_update : native %v bytes, compact %v bytes\n", len(native), len(compact));
+	testing.expect(t, len(compact) * 2 < len(native), "the compact encoding should be less then half the size");
+
+	val, err := deserialize_from_bytes_compact(Player_update, compact[:], context.temp_allocator);
+	testing.expect_value(t, err, Serialization_error.ok);
+	if err == .ok {
+		back := val.(Player_update);
+		testing.expect_value(t, back.id, 42);
+		testing.expect_value(t, back.health, 100);
+		testing.expect_value(t, back.delta, -3);
+		testing.expect_value(t, back.kind, Kind.running);
+		for p, i in back.position {
+			testing.expectf(t, abs(p - update.position[i]) <= 0.005, "position[%v] is %v, expected %v", i, p, update.position[i]);
+		}
+		testing.expect_value(t, back.angle, 1.25);
+		testing.expect_value(t, back.name, "bob");
+		testing.expect_value(t, len(back.hits), 3);
+		testing.expect_value(t, back.hits[2], 70_000);
+	}
+
+	//Varints at the edges.
+	for v in ([]i64{0, -1, 1, 63, -64, 64, max(i64), min(i64)}) {
+		tmp : [10]u8;
+		n := compact_put_uvarint(&tmp, zigzag_encode(v));
+		used := 0;
+		got, ok := compact_get_uvarint(tmp[:n], &used);
+		testing.expect(t, ok && used == n);
+		testing.expect_value(t, zigzag_decode(got), v);
+	}
+
+	free_all(context.temp_allocator);
+}
+
+@test
+test_jobs :: proc (t : ^testing.T) {
+
+	//Every job adds its number to the sum, the group is done when all of them are.
+	Job_data :: struct {
+		sum : ^int,
+		value : int,
+	}
+
+	sum := 0;
+	datas := make([]Job_data, 1 << 10, context.temp_allocator);
+
+	job_proc : Job_proc : proc (data : rawptr) {
+		d := cast(^Job_data)data;
+		intrinsics.atomic_add(d.sum, d.value);
+	}
+
+	group := job_group();
+	expected := 0;
+	for i in 0..<len(datas) {
+		datas[i] = {&sum, i};
+		expected += i;
+		job_spawn(job_proc, &datas[i], group);
+	}
+	job_run(group);
+	job_wait(group);
+
+	testing.expect_value(t, job_is_done(group), true);
+	testing.expect_value(t, intrinsics.atomic_load(&sum), expected);
+
+	//Waiting inside a job, the waiting worker runs the children itself if no one else does.
+	Outer :: struct {
+		sum : ^int,
+		inner : [8]Job_data,
+	}
+	outer := Outer{sum = &sum};
+	sum = 0;
+	outer_proc : Job_proc : proc (data : rawptr) {
+		o := cast(^Outer)data;
+		inner_proc : Job_proc : proc (data : rawptr) {
+			d := cast(^Job_data)data;
+			intrinsics.atomic_add(d.sum, d.value);
+		}
+		children := job_group();
+		for &d, i in o.inner {
+			d = {o.sum, i + 1};
+			job_spawn(inner_proc, &d, children);
+		}
+		job_run(children);
+		job_wait(children);
+		intrinsics.atomic_add(o.sum, 100);
+	}
+	job_wait(job_spawn(outer_proc, &outer));
+	testing.expect_value(t, intrinsics.atomic_load(&sum), 100 + 36);
+
+	free_all(context.temp_allocator);
+}
+
+@test
+test_parallel_for :: proc (t : ^testing.T) {
+
+	//Every index is written exactly once.
+	values := make([]int, 100_000, context.temp_allocator);
+	parallel_for({0, len(values)}, 0, &values, proc (values : ^[]int, begin, end : int) {
+		for i in begin..<end {
+			values[i] += i * 2;
+		}
+	});
+	for v, i in values {
+		if v != i * 2 {
+			testing.expectf(t, false, "values[%v] is %v, expected %v", i, v, i * 2);
+			break;
+		}
+	}
+
+	//The chunks are combined in order, so the result is the same as a loop.
+	sum := parallel_reduce({0, len(values)}, 1000, &values, 0, proc (values : ^[]int, begin, end : int) -> int {
+		s := 0;
+		for v in values[begin:end] {
+			s += v;
+		}
+		return s;
+	}, proc (a, b : int) -> int {
+		return a + b;
+	});
+	testing.expect_value(t, sum, len(values) * (len(values) - 1));
+
+	//A parallel_for in a body runs serially, but must still do all of it.
+	rows := make([][64]int, 64, context.temp_allocator);
+	parallel_for({0, len(rows)}, 1, &rows, proc (rows : ^[][64]int, begin, end : int) {
+		for r in begin..<end {
+			Row :: struct { row : ^[64]int, index : int };
+			row := Row{&rows[r], r};
+			parallel_for({0, 64}, 1, &row, proc (row : ^Row, begin, end : int) {
+				for c in begin..<end {
+					row.row[c] = row.index * 64 + c;
+				}
+			});
+		}
+	});
+	for row, r in rows {
+		for v, c in row {
+			testing.expect_value(t, v, r * 64 + c);
+		}
+	}
+
+	//The same as matrix_mul but serial, for comparison (the time depends on the machine, so it is only printed).
+	Size :: 256;
+	A := matrix_make(Size, Size, f64);
+	B := matrix_make(Size, Size, f64);
+	defer matrix_destroy(A);
+	defer matrix_destroy(B);
+	for i in 0..<Size * Size {
+		A.data[i] = cast(f64)(i % 7);
+		B.data[i] = cast(f64)(i % 5) - 2;
+	}
+
+	sw : time.Stopwatch;
+	time.stopwatch_start(&sw);
+	serial := make([]f64, Size * Size);
+	defer delete(serial);
+	for i in 0..<Size {
+		for j in 0..<Size {
+			s : f64;
+			for k in 0..<Size {
+				s += A.data[i * Size + k] * B.data[k * Size + j];
+			}
+			serial[i * Size + j] = s;
+		}
+	}
+	time.stopwatch_stop(&sw);
+	serial_time := time.stopwatch_duration(sw);
+
+	time.stopwatch_reset(&sw);
+	time.stopwatch_start(&sw);
+	res := matrix_mul(A, B);
+	time.stopwatch_stop(&sw);
+	defer matrix_destroy(res);
+
+	testing.expect(t, slice.equal(res.data, serial), "matrix_mul differs from the serial result");
+	fmt.printf("matrix_mul %vx%v : serial %v, parallel %v (%v workers)\n", Size, Size, serial_time, time.stopwatch_duration(sw), jobs_worker_count());
+
+	free_all(context.temp_allocator);
+}
+
+@test
+test_task_graph :: proc (t : ^testing.T) {
+
+	//A diamond, b and c wait on a, d waits on both. The tasks on the owner must run on this thread.
+	Graph_data :: struct {
+		order : [4]int,
+		counter : int,
+		owner : int,
+		wrong_thread : bool,
+	}
+	data : Graph_data;
+	data.owner = sync.current_thread_id();
+
+	task_a :: proc (data : rawptr) {
+		d := cast(^Graph_data)data;
+		d.wrong_thread |= sync.current_thread_id() != d.owner;
+		d.order[0] = intrinsics.atomic_add(&d.counter, 1);
+	}
+	task_b :: proc (data : rawptr) {
+		d := cast(^Graph_data)data;
+		time.sleep(5 * time.Millisecond);
+		d.order[1] = intrinsics.atomic_add(&d.counter, 1);
+	}
+	task_c :: proc (data : rawptr) {
+		d := cast(^Graph_data)data;
+		d.order[2] = intrinsics.atomic_add(&d.counter, 1);
+	}
+	task_d :: proc (data : rawptr) {
+		d := cast(^Graph_data)data;
+		d.wrong_thread |= sync.current_thread_id() != d.owner;
+		d.order[3] = intrinsics.atomic_add(&d.counter, 1);
+	}
+
+	graph : Task_graph;
+	defer task_graph_destroy(&graph);
+	a := task_graph_add(&graph, "a", task_a, &data, true);
+	b := task_graph_add(&graph, "b", task_b, &data, false, a);
+	c := task_graph_add(&graph, "c", task_c, &data, false, a);
+	d := task_graph_add(&graph, "d", task_d, &data, true, b, c);
+
+	for _ in 0..<3 {
+		data.counter = 0;
+		task_graph_run(&graph);
+
+		testing.expect_value(t, data.counter, 4);
+		testing.expect_value(t, data.order[0], 0);
+		testing.expect(t, data.order[1] > data.order[0] && data.order[2] > data.order[0], "b and c must run after a");
+		testing.expect_value(t, data.order[3], 3);
+		testing.expect(t, !data.wrong_thread, "an on_owner task ran on another thread");
+	}
+
+	//b sleeps, so the frame waited on a, b, d.
+	path, length := task_graph_critical_path(&graph);
+	testing.expect_value(t, len(path), 3);
+	if len(path) == 3 {
+		testing.expect_value(t, path[0], a);
+		testing.expect_value(t, path[1], b);
+		testing.expect_value(t, path[2], d);
+	}
+	testing.expect(t, length >= 5 * time.Millisecond, "the critical path is shorter then the sleep");
+	task_graph_print_timings(&graph);
+
+	free_all(context.temp_allocator);
+}
@@ -0,0 +1,319 @@
+package main
+
+//Serialization throughput, every message shape is serialized and deserialized in every format, reporting ns/op, MB/s and allocations per op.
+//Run with : odin run utils/benchmark -o:speed -- -seconds=0.5 -shape=all -format=all -large_count=65536 -csv=false
+//Every option is -name=value, see Config. With -csv=true the results are printed as csv, so they can be collected over time.
+
+import "core:fmt"
+import "core:mem"
+import "core:os"
+import "core:reflect"
+import "core:strconv"
+import "core:strings"
+import "core:time"
+
+import mem_virtual "core:mem/virtual"
+
+import "../../utils"
+
+//A small plain data message, this is a single copy.
+Small_pod :: struct {
+	id : u32,
+	flags : u16,
+	position : [3]f32,
+	velocity : [3]f32,
+}
+
+With_strings :: struct {
+	id : u32,
+	name : string,
+	title : string,
+	tags : [4]string,
+}
+
+Large_payload :: struct {
+	id : u32,
+	samples : [dynamic]f32,
+}
+
+Nested :: struct {
+	name : string,
+	values : [dynamic]i32,
+	children : [dynamic]Nested,
+}
+
+Shape :: enum {
+	small,
+	strings,
+	large,
+	nested,
+}
+
+Format :: enum {
+	plan,			//serialize_to_bytes / deserialize_from_bytes
+	reflected,		//The per call reflection it replaced
+	compact,		//The varint encoding
+	packed,			//deserialize_from_bytes_packed (serializes like plan)
+}
+
+Config :: struct {
+	seconds : f64,				//Per shape, format and direction.
+	shapes : bit_set[Shape],
+	formats : bit_set[Format],
+	large_count : int,			//The samples in Large_payload.
+	nested_depth : int,
+	nested_fanout : int,
+	csv : bool,
+}
+
+Default_config :: Config{
+	seconds = 0.5,
+	shapes = {.small, .strings, .large, .nested},
+	formats = {.plan, .reflected, .compact, .packed},
+	large_count = 64 * 1024,
+	nested_depth = 4,
+	nested_fanout = 3,
+	csv = false,
+}
+
+Result :: struct {
+	shape : Shape,
+	format : Format,
+	err : utils.Serialization_error,
+	bytes : int,				//per op
+	ser_ns, de_ns : f64,
+	ser_allocs, de_allocs : f64,
+}
+
+parse_config :: proc (args : []string) -> (config : Config, ok : bool) {
+	config = Default_config;
+
+	for arg in args {
+		parts := strings.split_n(strings.trim_left(arg, "-"), "=", 2, context.temp_allocator);
+		if len(parts) != 2 {
+			fmt.printf("Expected -name=value, got %v\n", arg);
+			return config, false;
+		}
+		name, value := parts[0], parts[1];
+
+		switch name {
+			case "seconds":			config.seconds = strconv.parse_f64(value) or_return;
+			case "large_count":		config.large_count = strconv.parse_int(value) or_return;
+			case "nested_depth":	config.nested_depth = strconv.parse_int(value) or_return;
+			case "nested_fanout":	config.nested_fanout = strconv.parse_int(value) or_return;
+			case "csv":				config.csv = strconv.parse_bool(value) or_return;
+			case "shape":
+				if value != "all" {
+					config.shapes = {};
+					for s in strings.split(value, ",", context.temp_allocator) {
+						shape, found := reflect.enum_from_name(Shape, s);
+						if !found {
+							fmt.printf("Unknown shape %v, expected all or a list of %v\n", s, Shape);
+							return config, false;
+						}
+						config.shapes += {shape};
+					}
+				}
+			case "format":
+				if value != "all" {
+					config.formats = {};
+					for s in strings.split(value, ",", context.temp_allocator) {
+						format, found := reflect.enum_from_name(Format, s);
+						if !found {
+							fmt.printf("Unknown format %v, expected all or a list of %v\n", s, Format);
+							return config, false;
+						}
+						config.formats += {format};
+					}
+				}
+			case:
+				fmt.printf("Unknown option %v\n", name);
+				return config, false;
+		}
+	}
+
+	return config, true;
+}
+
+make_nested :: proc (depth, fanout : int) -> (n : Nested) {
+	n.name = fmt.aprintf("level %v", depth);
+	n.values = make([dynamic]i32, 0, 16);
+	for i in 0..<16 {
+		append(&n.values, cast(i32)(i * depth - 40));
+	}
+	if depth > 0 {
+		n.children = make([dynamic]Nested, 0, fanout);
+		for _ in 0..<fanout {
+			append(&n.children, make_nested(depth - 1, fanout));
+		}
+	}
+	return;
+}
+
+//The value of each shape, they live until the program ends.
+make_value :: proc (shape : Shape, config : Config) -> any {
+	switch shape {
+		case .small:
+			v := new(Small_pod);
+			v^ = {id = 7, flags = 3, position = {1, 2, 3}, velocity = {-0.5, 0, 0.25}};
+			return any{data = v, id = Small_pod};
+		case .strings:
+			v := new(With_strings);
+			v^ = {id = 7, name = "a player name", title = "the title of the player", tags = {"red", "team two", "", "veteran"}};
+			return any{data = v, id = With_strings};
+		case .large:
+			v := new(Large_payload);
+			v.id = 7;
+			v.samples = make([dynamic]f32, config.large_count);
+			for &s, i in v.samples {
+				s = cast(f32)i * 0.5;
+			}
+			return any{data = v, id = Large_payload};
+		case .nested:
+			v := new(Nested);
+			v^ = make_nested(config.nested_depth, config.nested_fanout);
+			return any{data = v, id = Nested};
+	}
+	unreachable();
+}
+
+serialize :: proc (format : Format, value : any, buf : ^[dynamic]u8) -> utils.Serialization_error {
+	switch format {
+		case .plan, .packed:	return utils.serialize_to_bytes(value, buf);
+		case .reflected:		return utils.serialize_to_bytes_reflected(value, buf);
+		case .compact:			return utils.serialize_to_bytes_compact(value, buf);
+	}
+	unreachable();
+}
+
+deserialize :: proc (format : Format, type : typeid, data : []u8, alloc : mem.Allocator) -> utils.Serialization_error {
+	err : utils.Serialization_error;
+	switch format {
+		case .plan:			_, err = utils.deserialize_from_bytes(type, data, alloc);
+		case .reflected:	_, err = utils.deserialize_from_bytes_reflected(type, data, alloc);
+		case .compact:		_, err = utils.deserialize_from_bytes_compact(type, data, alloc);
+		case .packed:		_, err = utils.deserialize_from_bytes_packed(type, data, alloc);
+	}
+	return err;
+}
+
+run :: proc (shape : Shape, format : Format, value : any, config : Config) -> (res : Result) {
+	res.shape = shape;
+	res.format = format;
+
+	budget := cast(time.Duration)(config.seconds * cast(f64)time.Second);
+
+	counter := utils.Counting_allocator{backing = context.allocator};
+	buf := make([dynamic]u8, utils.counting_allocator(&counter));
+	defer delete(buf);
+
+	//The reflected path copies the children of Nested as raw bytes, it does not fail but the result is wrong.
+	if format == .reflected && shape == .nested {
+		res.err = .type_not_supported;
+		return;
+	}
+
+	//Once to check it works and to know the size, this also builds the plans so they are not timed.
+	res.err = serialize(format, value, &buf);
+	if res.err != .ok {
+		return;
+	}
+	res.bytes = len(buf);
+
+	{
+		//Also the allocations serialize does itself, not only the ones growing buf.
+		context.allocator = utils.counting_allocator(&counter);
+
+		counter.allocations = 0;
+		ops := 0;
+		start := time.tick_now();
+		for time.tick_since(start) < budget {
+			for _ in 0..<64 {
+				clear(&buf);
+				serialize(format, value, &buf);
+			}
+			ops += 64;
+		}
+		elapsed := time.tick_since(start);
+		res.ser_ns = cast(f64)elapsed / cast(f64)ops;
+		res.ser_allocs = cast(f64)counter.allocations / cast(f64)ops;
+	}
+
+	{
+		//The values are put in an arena that is reset every op, so the freeing is not what is measured.
+		arena : mem_virtual.Arena;
+		if mem_virtual.arena_init_growing(&arena) != nil {
+			panic("Failed to make the arena");
+		}
+		defer mem_virtual.arena_destroy(&arena);
+
+		de_counter := utils.Counting_allocator{backing = mem_virtual.arena_allocator(&arena)};
+		alloc := utils.counting_allocator(&de_counter);
+
+		res.err = deserialize(format, value.id, buf[:], alloc);
+		if res.err != .ok {
+			return;
+		}
+		free_all(alloc);
+
+		de_counter.allocations = 0;
+		ops := 0;
+		start := time.tick_now();
+		for time.tick_since(start) < budget {
+			for _ in 0..<64 {
+				deserialize(format, value.id, buf[:], alloc);
+				free_all(alloc);
+			}
+			ops += 64;
+		}
+		elapsed := time.tick_since(start);
+		res.de_ns = cast(f64)elapsed / cast(f64)ops;
+		res.de_allocs = cast(f64)de_counter.allocations / cast(f64)ops;
+	}
+
+	return;
+}
+
+mb_per_s :: proc (bytes : int, ns : f64) -> f64 {
+	return cast(f64)bytes / ns * 1e9 / (1024 * 1024);
+}
+
+main :: proc () {
+	config, ok := parse_config(os.args[1:]);
+	if !ok {
+		os.exit(1);
+	}
+
+	if config.csv {
+		fmt.printf("shape,format,bytes,serialize_ns,serialize_mb_s,serialize_allocs,deserialize_ns,deserialize_mb_s,deserialize_allocs\n");
+	}
+	else {
+		fmt.printf("%-8s %-10s %10s | %12s %10s %8s | %12s %10s %8s\n", "shape", "format", "bytes/op", "ser ns/op", "ser MB/s", "allocs", "de ns/op", "de MB/s", "allocs");
+	}
+
+	for shape in config.shapes {
+		value := make_value(shape, config);
+
+		for format in config.formats {
+			res := run(shape, format, value, config);
+
+			if res.err != .ok {
+				if !config.csv {
+					fmt.printf("%-8v %-10v %v\n", shape, format, res.err);
+				}
+				continue;
+			}
+
+			if config.csv {
+				fmt.printf("%v,%v,%v,%.1f,%.1f,%.2f,%.1f,%.1f,%.2f\n", shape, format, res.bytes,
+					res.ser_ns, mb_per_s(res.bytes, res.ser_ns), res.ser_allocs,
+					res.de_ns, mb_per_s(res.bytes, res.de_ns), res.de_allocs);
+			}
+			else {
+				fmt.printf("%-8v %-10v %10v | %12.1f %10.1f %8.2f | %12.1f %10.1f %8.2f\n", shape, format, res.bytes,
+					res.ser_ns, mb_per_s(res.bytes, res.ser_ns), res.ser_allocs,
+					res.de_ns, mb_per_s(res.bytes, res.de_ns), res.de_allocs);
+			}
+		}
+	}
+}